@@ -0,0 +1,363 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A benchmark of the checks of automounted file systems
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Usage: bench_automount [KEYS [DELAY [COMMAND [ARG]...]]]
+
+   Set up, in a private mount namespace, an indirect autofs map of KEYS
+   browsable keys (default: 200), served by a minimal automount daemon
+   that mounts a tmpfs on a key DELAY milliseconds (default: 2) after it
+   is looked up, as a stand-in for the mount of an NFS export.  Then
+   report the time taken to look at every key, both opening it, which
+   triggers its automount as check_readonlyfs does, and with fstatat and
+   AT_NO_AUTOMOUNT, as check_readonlyfs --no-automount does, along with
+   the number of keys mounted.  If COMMAND is given, it is run instead,
+   with the paths of the keys as last arguments, both with no key mounted
+   and with all of them mounted.  The keys are unmounted after each
+   pass.  This needs to be run as root, and is skipped otherwise.  */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined __linux__ && HAVE_LINUX_AUTO_FS_H
+# include <errno.h>
+# include <fcntl.h>
+# include <pthread.h>
+# include <sched.h>
+# include <signal.h>
+# include <sys/ioctl.h>
+# include <sys/mount.h>
+# include <sys/stat.h>
+# include <sys/wait.h>
+# include <unistd.h>
+# include <linux/auto_fs.h>
+
+/* Number of passes of each step.  */
+#define BENCH_PASSES 3
+
+/* The automount daemon.  */
+struct automountd
+{
+  char ad_dir[64];		/* Mount point of the autofs map. */
+  int ad_pipe;			/* Read end of the kernel requests. */
+  int ad_ioctl;			/* Descriptor of the map, for the replies. */
+  unsigned int ad_delay;	/* Delay of each mount, in milliseconds. */
+};
+
+/* A mount request of a key.  */
+struct mount_request
+{
+  struct automountd *mr_daemon;
+  autofs_wqt_t mr_token;
+  char mr_name[NAME_MAX + 1];
+};
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Mount the key of the request ARG, and wake up the processes waiting
+   for it.  */
+static void *
+mount_key (void *arg)
+{
+  struct mount_request *mr = arg;
+  struct automountd *ad = mr->mr_daemon;
+  struct timespec delay;
+  char path[sizeof ad->ad_dir + NAME_MAX + 1];
+
+  delay.tv_sec = ad->ad_delay / 1000;
+  delay.tv_nsec = (ad->ad_delay % 1000) * 1000000L;
+  nanosleep (&delay, NULL);
+
+  snprintf (path, sizeof path, "%s/%s", ad->ad_dir, mr->mr_name);
+  if (mount ("bench", path, "tmpfs", 0, "size=64k") == 0)
+    ioctl (ad->ad_ioctl, AUTOFS_IOC_READY, mr->mr_token);
+  else
+    ioctl (ad->ad_ioctl, AUTOFS_IOC_FAIL, mr->mr_token);
+
+  free (mr);
+  return NULL;
+}
+
+/* Serve the requests of the kernel, each one in its own thread, as the
+   automount daemon does.  */
+static void *
+serve (void *arg)
+{
+  struct automountd *ad = arg;
+  union autofs_v5_packet_union pkt;
+
+  while (read (ad->ad_pipe, &pkt, sizeof pkt) > 0)
+    {
+      struct mount_request *mr;
+      pthread_attr_t attr;
+      pthread_t thread;
+
+      if (pkt.hdr.type != autofs_ptype_missing_indirect)
+	{
+	  ioctl (ad->ad_ioctl, AUTOFS_IOC_FAIL,
+		 pkt.v5_packet.wait_queue_token);
+	  continue;
+	}
+
+      mr = malloc (sizeof *mr);
+      if (mr == NULL)
+	{
+	  ioctl (ad->ad_ioctl, AUTOFS_IOC_FAIL,
+		 pkt.v5_packet.wait_queue_token);
+	  continue;
+	}
+      mr->mr_daemon = ad;
+      mr->mr_token = pkt.v5_packet.wait_queue_token;
+      snprintf (mr->mr_name, sizeof mr->mr_name, "%.*s",
+		(int) pkt.v5_packet.len, pkt.v5_packet.name);
+
+      pthread_attr_init (&attr);
+      pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+      if (pthread_create (&thread, &attr, mount_key, mr) != 0)
+	{
+	  ioctl (ad->ad_ioctl, AUTOFS_IOC_FAIL, mr->mr_token);
+	  free (mr);
+	}
+      pthread_attr_destroy (&attr);
+    }
+
+  return NULL;
+}
+
+/* Mount the autofs map of AD with N keys, and start its daemon.  Return
+   false on error.  */
+static bool
+start_automountd (struct automountd *ad, unsigned long n)
+{
+  char opts[128], path[sizeof ad->ad_dir + 32];
+  pthread_t thread;
+  unsigned long i;
+  int fds[2];
+
+  strcpy (ad->ad_dir, "/tmp/bench_automount.XXXXXX");
+  if (mkdtemp (ad->ad_dir) == NULL || pipe (fds) != 0)
+    return false;
+
+  snprintf (opts, sizeof opts,
+	    "fd=%d,pgrp=%ld,minproto=5,maxproto=5,indirect",
+	    fds[1], (long) getpgrp ());
+  if (mount ("bench", ad->ad_dir, "autofs", 0, opts) != 0)
+    {
+      rmdir (ad->ad_dir);
+      return false;
+    }
+  close (fds[1]);
+  ad->ad_pipe = fds[0];
+  ad->ad_ioctl = open (ad->ad_dir, O_RDONLY | O_DIRECTORY);
+
+  /* Only the daemon can create the keys, which makes them browsable.  */
+  for (i = 0; i < n; i++)
+    {
+      snprintf (path, sizeof path, "%s/key%lu", ad->ad_dir, i);
+      if (mkdir (path, 0755) != 0)
+	return false;
+    }
+
+  return ad->ad_ioctl >= 0
+    && pthread_create (&thread, NULL, serve, ad) == 0;
+}
+
+/* Unmount the N keys of AD, and return the number of them that were
+   mounted.  */
+static unsigned long
+unmount_keys (struct automountd *ad, unsigned long n)
+{
+  char path[sizeof ad->ad_dir + 32];
+  unsigned long i, mounted = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      snprintf (path, sizeof path, "%s/key%lu", ad->ad_dir, i);
+      if (umount2 (path, MNT_DETACH) == 0)
+	mounted++;
+    }
+
+  return mounted;
+}
+
+/* Look at the N keys of AD, triggering their automount if TRIGGER is
+   true.  */
+static void
+look_at_keys (struct automountd *ad, unsigned long n, bool trigger)
+{
+  char path[sizeof ad->ad_dir + 32];
+  unsigned long i;
+  struct stat st;
+
+  for (i = 0; i < n; i++)
+    {
+      snprintf (path, sizeof path, "%s/key%lu", ad->ad_dir, i);
+      if (trigger)
+	{
+	  int fd = open (path, O_RDONLY | O_NOCTTY);
+	  if (fd >= 0)
+	    {
+	      fstat (fd, &st);
+	      close (fd);
+	    }
+	}
+      else
+	fstatat (AT_FDCWD, path, &st, AT_NO_AUTOMOUNT);
+    }
+}
+
+/* Run COMMAND with the paths of the N keys of AD appended.  */
+static void
+run_command (struct automountd *ad, unsigned long n, char **command)
+{
+  size_t argc = 0, i;
+  char **argv;
+
+  while (command[argc])
+    argc++;
+  argv = calloc (argc + n + 1, sizeof *argv);
+  if (argv == NULL)
+    _exit (EXIT_FAILURE);
+  for (i = 0; i < argc; i++)
+    argv[i] = command[i];
+  for (i = 0; i < n; i++)
+    {
+      argv[argc + i] = malloc (sizeof ad->ad_dir + 32);
+      if (argv[argc + i] == NULL)
+	_exit (EXIT_FAILURE);
+      sprintf (argv[argc + i], "%s/key%lu", ad->ad_dir, (unsigned long) i);
+    }
+
+  /* The output of the command is not measured.  */
+  if (freopen ("/dev/null", "w", stdout) == NULL)
+    _exit (EXIT_FAILURE);
+  execvp (argv[0], argv);
+  _exit (127);
+}
+
+/* Run a pass of STEP, in a child process outside of the process group of
+   the daemon, which is never served by autofs, and report its time.  The
+   keys are then unmounted, unless KEEP is true.  */
+static void
+run_pass (struct automountd *ad, char const *step, unsigned long n,
+	  bool trigger, char **command, bool keep)
+{
+  double start = now (), elapsed;
+  unsigned long mounted;
+  int status;
+  pid_t pid;
+
+  fflush (stdout);
+  pid = fork ();
+  if (pid == 0)
+    {
+      setpgid (0, 0);
+      if (command)
+	run_command (ad, n, command);
+      look_at_keys (ad, n, trigger);
+      _exit (EXIT_SUCCESS);
+    }
+  if (pid < 0 || waitpid (pid, &status, 0) < 0)
+    {
+      perror ("cannot run the pass");
+      exit (EXIT_FAILURE);
+    }
+  elapsed = now () - start;
+
+  mounted = keep ? n : unmount_keys (ad, n);
+  printf ("  %-20s %10.2f ms/pass %10.1f us/key %6lu mounted",
+	  step, elapsed * 1e3, elapsed * 1e6 / n, mounted);
+  if (command)
+    printf (" (exit status %d)", WIFEXITED (status)
+	    ? WEXITSTATUS (status) : -1);
+  putchar ('\n');
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned long n = argc > 1 ? strtoul (argv[1], NULL, 10) : 200;
+  unsigned int delay = argc > 2 ? strtoul (argv[2], NULL, 10) : 2;
+  char **command = argc > 3 ? argv + 3 : NULL;
+  struct automountd ad;
+  int pass;
+
+  if (n == 0)
+    {
+      fprintf (stderr, "Usage: %s [KEYS [DELAY [COMMAND [ARG]...]]]\n",
+	       argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  /* Nothing is mounted outside of a private mount namespace.  */
+  if (geteuid () != 0 || unshare (CLONE_NEWNS) != 0
+      || mount (NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) != 0)
+    {
+      puts ("bench_automount: skipped, root privileges are required");
+      return EXIT_SUCCESS;
+    }
+
+  ad.ad_delay = delay;
+  if (!start_automountd (&ad, n))
+    {
+      printf ("bench_automount: skipped, cannot set up autofs: %s\n",
+	      strerror (errno));
+      return EXIT_SUCCESS;
+    }
+  signal (SIGPIPE, SIG_IGN);
+
+  printf ("autofs map: %lu keys, mounted in %u ms\n", n, delay);
+  for (pass = 0; pass < BENCH_PASSES; pass++)
+    if (command)
+      {
+	run_pass (&ad, "unmounted", n, true, command, false);
+	run_pass (&ad, "mount", n, true, NULL, true);
+	run_pass (&ad, "mounted", n, true, command, false);
+      }
+    else
+      {
+	run_pass (&ad, "open (trigger)", n, true, NULL, false);
+	run_pass (&ad, "AT_NO_AUTOMOUNT", n, false, NULL, false);
+      }
+
+  return EXIT_SUCCESS;
+}
+
+#else /* !(__linux__ && HAVE_LINUX_AUTO_FS_H) */
+
+int
+main (void)
+{
+  puts ("bench_automount: skipped, autofs is not supported");
+  return EXIT_SUCCESS;
+}
+
+#endif
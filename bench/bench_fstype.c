@@ -0,0 +1,124 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A micro-benchmark of the file system type classifier
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fstype.h"
+
+/* The macros used before, which compare the type to each name in turn.  */
+#define LEGACY_DUMMY(Fs_name, Fs_type)          \
+    (strcmp (Fs_type, "autofs") == 0            \
+     || strcmp (Fs_type, "binfmt_misc") == 0    \
+     || strcmp (Fs_type, "devpts") == 0         \
+     || strcmp (Fs_type, "fusectl") == 0        \
+     || strcmp (Fs_type, "none") == 0           \
+     || strcmp (Fs_type, "proc") == 0           \
+     || strcmp (Fs_type, "subfs") == 0          \
+     || strcmp (Fs_type, "kernfs") == 0         \
+     || strcmp (Fs_type, "ignore") == 0)
+
+#define LEGACY_REMOTE(Fs_name, Fs_type)         \
+    (strchr (Fs_name, ':') != NULL              \
+     || ((Fs_name)[0] == '/'                    \
+         && (Fs_name)[1] == '/'                 \
+         && (strcmp (Fs_type, "smbfs") == 0     \
+             || strcmp (Fs_type, "cifs") == 0)))
+
+/* The device names and types of a container host, in the proportions of
+   its mount table: mostly overlay, nsfs, tmpfs and bind mounts.  */
+static char const *const samples[][2] = {
+  {"overlay", "overlay"},
+  {"overlay", "overlay"},
+  {"overlay", "overlay"},
+  {"nsfs", "nsfs"},
+  {"nsfs", "nsfs"},
+  {"tmpfs", "tmpfs"},
+  {"tmpfs", "tmpfs"},
+  {"shm", "tmpfs"},
+  {"/dev/sda1", "ext4"},
+  {"/dev/sda1", "ext4"},
+  {"/dev/mapper/vg-data", "xfs"},
+  {"proc", "proc"},
+  {"sysfs", "sysfs"},
+  {"devpts", "devpts"},
+  {"mqueue", "mqueue"},
+  {"cgroup2", "cgroup2"},
+  {"tracefs", "tracefs"},
+  {"systemd-1", "autofs"},
+  {"nfs01:/export/home", "nfs4"},
+  {"//files/share", "cifs"},
+};
+
+#define N_SAMPLES (sizeof samples / sizeof samples[0])
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned long iterations = (argc > 1) ? strtoul (argv[1], NULL, 10)
+    : 1000000;
+  unsigned long i, found = 0;
+  double start, legacy, hashed;
+  size_t j;
+
+  /* Load the types of the running kernel out of the timed loops.  */
+  fstype_classify ("");
+
+  start = now ();
+  for (i = 0; i < iterations; i++)
+    for (j = 0; j < N_SAMPLES; j++)
+      found += LEGACY_DUMMY (samples[j][0], samples[j][1])
+	+ LEGACY_REMOTE (samples[j][0], samples[j][1]);
+  legacy = now () - start;
+
+  start = now ();
+  for (i = 0; i < iterations; i++)
+    for (j = 0; j < N_SAMPLES; j++)
+      {
+	enum fstype_class class = fstype_classify (samples[j][1]);
+	found += FSTYPE_IS_DUMMY (class)
+	  + (strchr (samples[j][0], ':') != NULL || class == FSTYPE_REMOTE);
+      }
+  hashed = now () - start;
+
+  printf ("file system types: %lu entries of %lu samples\n",
+	  iterations * N_SAMPLES, (unsigned long) N_SAMPLES);
+  printf ("  ME_DUMMY/ME_REMOTE strcmp chains  %8.1f ns/entry\n",
+	  legacy * 1e9 / (iterations * N_SAMPLES));
+  printf ("  fstype_classify                   %8.1f ns/entry\n",
+	  hashed * 1e9 / (iterations * N_SAMPLES));
+
+  /* Keep the compiler from optimizing the loops away.  */
+  return (found == 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,459 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A benchmark of the mount list, from parsing to the lookups
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Usage: bench_mountlist TABLE
+
+   Read the mount table file TABLE (see gen_mounttable) and report the
+   throughput of each step of a check: walk of the table an entry at a
+   time, to its end and stopping at its half and at its first tenth,
+   parsing of all the fields, and of
+   the mount points only, classification of the
+   types and options, filtering of the entries as done by check_readonlyfs
+   -l with 30 -X types, both on the list and on its compact table layout,
+   building of the index over the mount points and
+   the device numbers, and lookups of the mount points and of the device
+   numbers.  The resolution of paths inside the mounts to the mount holding
+   them is measured both with the trie over the mount points and with a
+   scan of the list for the longest matching mount point.  The selection
+   of the entries by mount point, as done by check_readonlyfs with 200 -E
+   patterns, is measured both with the compiled path set and with a loop
+   of fnmatch over the patterns.  Also report the number of allocations
+   done by the parser and by the index, and the peak resident set size,
+   after the walks and at the end.  */
+
+#include "config.h"
+
+#include <fnmatch.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "fstype.h"
+#include "fstypeset.h"
+#include "mountindex.h"
+#include "mountlist.h"
+#include "mountopts.h"
+#include "mounttable.h"
+#include "mounttrie.h"
+#include "pathset.h"
+
+/* Each step is repeated to process about this number of entries.  */
+#define BENCH_ENTRIES 2000000UL
+
+/* Number of paths resolved by scanning the whole list.  */
+#define SCAN_PATHS 1000UL
+
+/* Number of mount points matched by a loop of fnmatch over the
+   patterns.  */
+#define GLOB_PATHS 10000UL
+
+/* Number of -E patterns.  */
+#define PATH_PATTERNS 200
+
+/* The -E patterns of a container host, after those of a few hundred
+   tenant directories, so that they are the last ones tried by a loop over
+   the patterns.  */
+static char const *const container_patterns[] = {
+  "/var/lib/docker/overlay2/*/merged", "/var/lib/docker/containers/*/mounts",
+  "/run/docker/netns/*", "/var/lib/kubelet/pods/*/volumes/*"
+};
+
+/* The -X types of a check excluding every pseudo file system.  */
+static char const *const excluded_types[] = {
+  "autofs", "binfmt_misc", "bpf", "cgroup", "cgroup2", "configfs", "cpuset",
+  "debugfs", "devpts", "devtmpfs", "efivarfs", "fusectl", "hugetlbfs",
+  "mqueue", "nsfs", "overlay", "pipefs", "proc", "pstore", "ramfs",
+  "rpc_pipefs", "securityfs", "selinuxfs", "shm", "sockfs", "squashfs",
+  "sysfs", "tmpfs", "tracefs", "fuse.*"
+};
+
+#ifdef __GLIBC__
+/* Count the allocations by interposing the allocator of the C library.  */
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *p, size_t size);
+
+static unsigned long n_allocs;
+
+void *
+malloc (size_t size)
+{
+  n_allocs++;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  n_allocs++;
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *p, size_t size)
+{
+  n_allocs++;
+  return __libc_realloc (p, size);
+}
+
+# define ALLOCS_SUPPORTED 1
+#else
+# define n_allocs 0UL
+# define ALLOCS_SUPPORTED 0
+#endif
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report (char const *step, double seconds, unsigned long items)
+{
+  printf ("  %-10s %10.1f ns/entry %10.2f M entries/s\n", step,
+	  seconds * 1e9 / items, items / seconds / 1e6);
+}
+
+/* Return the last entry of MOUNT_LIST with the longest mount point
+   leading to PATH, as done without the trie.  */
+static struct mount_entry *
+scan_path (struct mount_entry *mount_list, char const *path)
+{
+  struct mount_entry *me, *best = NULL;
+  size_t best_len = 0;
+
+  for (me = mount_list; me; me = me->me_next)
+    {
+      size_t len = strlen (me->me_mountdir);
+
+      if (len == 1 && *me->me_mountdir == '/')
+	len = 0;
+      if (len >= best_len && strncmp (path, me->me_mountdir, len) == 0
+	  && (path[len] == '/' || path[len] == '\0'))
+	{
+	  best = me;
+	  best_len = len;
+	}
+    }
+
+  return best;
+}
+
+/* Return in PATTERNS the PATH_PATTERNS -E patterns of a check, each of
+   at most 64 bytes.  */
+static void
+make_path_patterns (char patterns[][64])
+{
+  size_t n_tenants = PATH_PATTERNS - sizeof container_patterns
+    / sizeof container_patterns[0];
+  size_t i;
+
+  for (i = 0; i < n_tenants; i++)
+    switch (i % 4)
+      {
+      case 0:
+	snprintf (patterns[i], 64, "/srv/tenant%03zu/*", i);
+	break;
+      case 1:
+	snprintf (patterns[i], 64, "/var/lib/docker/volumes/tenant%03zu-*", i);
+	break;
+      case 2:
+	snprintf (patterns[i], 64,
+		  "/var/lib/kubelet/plugins/csi-%03zu/*/globalmount", i);
+	break;
+      default:
+	snprintf (patterns[i], 64, "/mnt/nfs/share%03zu", i);
+	break;
+      }
+  for (; i < PATH_PATTERNS; i++)
+    strcpy (patterns[i], container_patterns[i - n_tenants]);
+}
+
+/* Count the entries walked, and stop at the limit given by ARG.  */
+static bool
+count_entry (struct mount_entry *me, void *arg)
+{
+  unsigned long *left = arg;
+
+  (void) me;
+  return --*left > 0;
+}
+
+/* Walk the mount table file TABLE up to LIMIT entries, and return the
+   number of entries walked.  */
+static unsigned long
+walk_entries (char const *table, unsigned long limit)
+{
+  unsigned long left = limit;
+
+  if (walk_mount_table (table, MOUNT_FIELD_MOUNTDIR, count_entry, &left) < 0)
+    return 0;
+  return limit - left;
+}
+
+static void
+report_allocs (char const *step, unsigned long allocs)
+{
+  if (ALLOCS_SUPPORTED)
+    printf ("  %-10s %10lu allocations\n", step, allocs);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct mount_entry *mount_list, *me;
+  struct fstype_set *exclude_set;
+  struct mount_index *index;
+  struct mount_trie *trie;
+  struct mount_table *table;
+  struct path_set *path_set;
+  char patterns[PATH_PATTERNS][64];
+  uint64_t *bits;
+  char **paths;
+  char const **dirs;
+  unsigned long n = 0, reps, i, found = 0, allocs;
+  struct rusage usage;
+  double start;
+  size_t j;
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "Usage: %s TABLE\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  /* The walks run first, so that the peak RSS they reach is not the one
+     of the whole list.  */
+  n = walk_entries (argv[1], (unsigned long) -1);
+  if (n == 0)
+    {
+      perror (argv[1]);
+      return EXIT_FAILURE;
+    }
+  reps = (BENCH_ENTRIES / n > 0) ? BENCH_ENTRIES / n : 1;
+
+  printf ("mount table %s: %lu entries\n", argv[1], n);
+
+  start = now ();
+  for (i = 0; i < reps; i++)
+    found += walk_entries (argv[1], n);
+  report ("walk", now () - start, reps * n);
+
+  start = now ();
+  for (i = 0; i < reps; i++)
+    found += walk_entries (argv[1], (n + 1) / 2);
+  report ("walk 1/2", now () - start, reps * n);
+
+  start = now ();
+  for (i = 0; i < reps; i++)
+    found += walk_entries (argv[1], (n + 9) / 10);
+  report ("walk 1/10", now () - start, reps * n);
+
+  getrusage (RUSAGE_SELF, &usage);
+  printf ("  %-10s %10.1f MiB\n", "walk RSS", usage.ru_maxrss / 1024.0);
+
+  allocs = n_allocs;
+  mount_list = read_mount_table (argv[1], MOUNT_FIELD_ALL);
+  allocs = n_allocs - allocs;
+  if (mount_list == NULL)
+    {
+      perror (argv[1]);
+      return EXIT_FAILURE;
+    }
+  start = now ();
+  for (i = 0; i < reps; i++)
+    free_mount_list (read_mount_table (argv[1], MOUNT_FIELD_ALL));
+  report ("parse", now () - start, reps * n);
+
+  /* What check_ifmount reads.  */
+  start = now ();
+  for (i = 0; i < reps; i++)
+    free_mount_list (read_mount_table (argv[1], MOUNT_FIELD_MOUNTDIR));
+  report ("parse dirs", now () - start, reps * n);
+
+  start = now ();
+  for (i = 0; i < reps; i++)
+    for (me = mount_list; me; me = me->me_next)
+      {
+	enum fstype_class class = fstype_classify (me->me_type);
+	found += FSTYPE_IS_DUMMY (class)
+	  + mount_options_flags (me->me_opts);
+      }
+  report ("classify", now () - start, reps * n);
+
+  exclude_set = fstype_set_new ();
+  for (j = 0; j < sizeof excluded_types / sizeof excluded_types[0]; j++)
+    fstype_set_add (exclude_set, excluded_types[j]);
+  start = now ();
+  for (i = 0; i < reps; i++)
+    for (me = mount_list; me; me = me->me_next)
+      found += !me->me_remote && !me->me_dummy
+	&& !fstype_set_match (exclude_set, me->me_type)
+	&& me->me_readonly;
+  report ("filter", now () - start, reps * n);
+
+  make_path_patterns (patterns);
+  path_set = path_set_new ();
+  for (j = 0; j < PATH_PATTERNS; j++)
+    path_set_add (path_set, patterns[j]);
+  start = now ();
+  for (i = 0; i < reps; i++)
+    for (me = mount_list; me; me = me->me_next)
+      found += path_set_match (path_set, me->me_mountdir);
+  report ("paths", now () - start, reps * n);
+
+  /* The same patterns, matched one at a time.  FNM_LEADING_DIR makes
+     them match the mounts below too.  */
+  dirs = malloc (n * sizeof *dirs);
+  for (me = mount_list, i = 0; me; me = me->me_next, i++)
+    dirs[i] = me->me_mountdir;
+  {
+    unsigned long count = (n < GLOB_PATHS) ? n : GLOB_PATHS;
+    unsigned long set_found = 0, glob_found = 0;
+
+    start = now ();
+    for (i = 0; i < count; i++)
+      for (j = 0; j < PATH_PATTERNS; j++)
+	if (fnmatch (patterns[j], dirs[i * n / count],
+		     FNM_PATHNAME | FNM_LEADING_DIR) == 0)
+	  {
+	    glob_found++;
+	    break;
+	  }
+    report ("paths glob", now () - start, count);
+
+    for (i = 0; i < count; i++)
+      set_found += path_set_match (path_set, dirs[i * n / count]);
+    if (set_found != glob_found)
+      {
+	fprintf (stderr, "path set matched %lu mount points, fnmatch %lu\n",
+		 set_found, glob_found);
+	return EXIT_FAILURE;
+      }
+    found += glob_found;
+  }
+  free (dirs);
+
+  start = now ();
+  for (i = 0; i < reps; i++)
+    mount_table_free (mount_table_new (mount_list));
+  report ("table", now () - start, reps * n);
+
+  table = mount_table_new (mount_list);
+  bits = malloc (table->mt_words * sizeof *bits);
+  start = now ();
+  for (i = 0; i < reps; i++)
+    {
+      size_t w, k;
+
+      mount_table_select (table, true, false, NULL, exclude_set, bits);
+      for (w = 0; w < table->mt_words; w++)
+	bits[w] &= table->mt_readonly[w];
+      for (k = mount_table_next (table, bits, 0); k < table->mt_count;
+	   k = mount_table_next (table, bits, k + 1))
+	found++;
+    }
+  report ("filter SoA", now () - start, reps * n);
+
+  start = now ();
+  for (i = 0; i < reps; i++)
+    mount_index_free (mount_index_new (mount_list));
+  report ("index", now () - start, reps * n);
+
+  index = mount_index_new (mount_list);
+  start = now ();
+  for (i = 0; i < reps; i++)
+    for (me = mount_list; me; me = me->me_next)
+      {
+	size_t count;
+	mount_index_lookup (index, me->me_mountdir, &count);
+	found += count;
+      }
+  report ("lookup", now () - start, reps * n);
+
+  start = now ();
+  for (i = 0; i < reps; i++)
+    for (me = mount_list; me; me = me->me_next)
+      {
+	size_t count;
+	mount_index_lookup_dev (index, me->me_dev, &count);
+	found += count;
+      }
+  report ("dev lookup", now () - start, reps * n);
+
+  /* Paths of files inside each mount.  */
+  paths = malloc (n * sizeof *paths);
+  for (me = mount_list, i = 0; me; me = me->me_next, i++)
+    {
+      size_t len = strlen (me->me_mountdir);
+      paths[i] = malloc (len + sizeof "/data/db/base/16384");
+      memcpy (paths[i], me->me_mountdir, len);
+      strcpy (paths[i] + len, "/data/db/base/16384");
+    }
+
+  start = now ();
+  for (i = 0; i < reps; i++)
+    mount_trie_free (mount_trie_new (mount_list));
+  report ("trie", now () - start, reps * n);
+
+  trie = mount_trie_new (mount_list);
+  start = now ();
+  for (i = 0; i < reps; i++)
+    for (j = 0; j < n; j++)
+      found += mount_trie_lookup (trie, paths[j]) != NULL;
+  report ("path trie", now () - start, reps * n);
+
+  start = now ();
+  for (i = 0; i < SCAN_PATHS; i++)
+    found += scan_path (mount_list, paths[i * n / SCAN_PATHS]) != NULL;
+  report ("path scan", now () - start, SCAN_PATHS);
+
+  report_allocs ("parse", allocs);
+  allocs = n_allocs;
+  mount_index_free (mount_index_new (mount_list));
+  report_allocs ("index", n_allocs - allocs);
+  allocs = n_allocs;
+  mount_trie_free (mount_trie_new (mount_list));
+  report_allocs ("trie", n_allocs - allocs);
+
+  getrusage (RUSAGE_SELF, &usage);
+  printf ("  %-10s %10.1f MiB\n", "peak RSS", usage.ru_maxrss / 1024.0);
+
+  for (j = 0; j < n; j++)
+    free (paths[j]);
+  free (paths);
+  free (bits);
+  mount_table_free (table);
+  mount_trie_free (trie);
+  mount_index_free (index);
+  fstype_set_free (exclude_set);
+  path_set_free (path_set);
+  free_mount_list (mount_list);
+
+  /* Keep the compiler from optimizing the loops away.  */
+  return (found == 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A benchmark of the backends reading the table of the mounted file systems
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Usage: bench_statmount [TABLE]
+
+   Read the table of the mounted file systems with the mount IDs, which
+   is done with listmount and statmount on GNU/Linux 6.8 and later, and
+   parse the mount table file TABLE (default: /proc/self/mountinfo), for
+   all the fields, for the fields of check_readonlyfs and for the mount
+   points only.  Unlike bench_mountlist this measures the kernel side too,
+   so it is only meaningful on a host, or in a mount namespace, with many
+   mounts.  */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mountlist.h"
+
+/* Each read is repeated to process about this number of entries.  */
+#define BENCH_ENTRIES 200000UL
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report (char const *step, double seconds, unsigned long items)
+{
+  printf ("  %-16s %10.1f ns/entry %10.2f M entries/s\n", step,
+	  seconds * 1e9 / items, items / seconds / 1e6);
+}
+
+/* Read the table TABLE, or the system table if TABLE is NULL, REPS times
+   with FIELDS, and report the time per entry of the N entries.  */
+static void
+bench_read (char const *step, char const *table, unsigned int fields,
+	    unsigned long reps, unsigned long n)
+{
+  double start = now ();
+  unsigned long i;
+
+  for (i = 0; i < reps; i++)
+    free_mount_list (read_mount_table (table, fields));
+  report (step, now () - start, reps * n);
+}
+
+int
+main (int argc, char **argv)
+{
+  char const *table = argc > 1 ? argv[1] : "/proc/self/mountinfo";
+  unsigned int const check_fields = MOUNT_FIELD_MOUNTDIR | MOUNT_FIELD_DEV
+    | MOUNT_FIELD_FLAGS | MOUNT_FIELD_CLASS;
+  struct mount_entry *mount_list, *me;
+  unsigned long n = 0, reps;
+
+  if (argc > 2)
+    {
+      fprintf (stderr, "Usage: %s [TABLE]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  mount_list = read_file_system_list (MOUNT_FIELD_ALL);
+  if (mount_list == NULL)
+    {
+      perror ("cannot read table of mounted file systems");
+      return EXIT_FAILURE;
+    }
+  for (me = mount_list; me; me = me->me_next)
+    n++;
+  reps = (BENCH_ENTRIES / n > 0) ? BENCH_ENTRIES / n : 1;
+
+  /* Only the entries read with statmount have a mount ID.  */
+  printf ("mounted file systems: %lu entries, read with %s\n", n,
+	  mount_list->me_mnt_id ? "statmount" : "the mount table file");
+  free_mount_list (mount_list);
+
+  bench_read ("statmount all", NULL, MOUNT_FIELD_ALL, reps, n);
+  bench_read ("statmount check", NULL, check_fields | MOUNT_FIELD_ID, reps, n);
+  bench_read ("statmount dirs", NULL, MOUNT_FIELD_MOUNTDIR | MOUNT_FIELD_ID,
+	      reps, n);
+  bench_read ("text all", table, MOUNT_FIELD_ALL, reps, n);
+  bench_read ("text check", table, check_fields, reps, n);
+  bench_read ("text dirs", table, MOUNT_FIELD_MOUNTDIR, reps, n);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,305 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A benchmark of the watch of the mount table during a storm of mounts
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Usage: bench_watch MOUNTS RATE COMMAND [ARG]...
+
+   Set up, in a private mount namespace, MOUNTS tmpfs mounts and a target
+   tmpfs, and run COMMAND, a watch of the mount table like
+   check_readonlyfs --watch, which is expected to exit when the target
+   turns readonly.  The CPU time used by COMMAND while the table does not
+   change is reported, then a storm of RATE mounts and unmounts per second
+   is started, and the target is remounted readonly in the middle of it.
+   The delay between the remount and the exit of COMMAND, the CPU time it
+   used, and the rate of the storm actually reached are reported, both
+   with the storm and without it.  This needs to be run as root, and is
+   skipped otherwise.  */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+# include <errno.h>
+# include <fcntl.h>
+# include <pthread.h>
+# include <sched.h>
+# include <signal.h>
+# include <sys/mount.h>
+# include <sys/resource.h>
+# include <sys/stat.h>
+# include <sys/wait.h>
+# include <unistd.h>
+
+/* Number of passes of each step.  */
+#define BENCH_PASSES 3
+
+/* Seconds of each phase of a pass: before the storm, while the command is
+   idle, and during the storm, before the target is remounted.  */
+#define SETTLE_TIME 0.5
+#define IDLE_TIME 1.0
+#define STORM_TIME 1.0
+
+/* Give up waiting for the command after this number of seconds.  */
+#define MAX_WAIT 30
+
+/* The storm of mounts.  */
+struct storm
+{
+  char st_dir[96];		/* Directory mounted and unmounted. */
+  unsigned long st_rate;	/* Events per second, 0 for none. */
+  volatile bool st_stop;
+  unsigned long st_events;	/* Mounts and unmounts done. */
+  double st_time;		/* Duration of the storm. */
+};
+
+static char bench_dir[] = "/tmp/bench_watch.XXXXXX";
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+sleep_for (double seconds)
+{
+  struct timespec ts;
+
+  ts.tv_sec = (time_t) seconds;
+  ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+  while (nanosleep (&ts, &ts) != 0 && errno == EINTR)
+    ;
+}
+
+/* Return the CPU time used so far by the process PID, in seconds, or -1
+   if unknown.  */
+static double
+cpu_time (pid_t pid)
+{
+  unsigned long utime, stime;
+  char path[64], buf[1024], *p;
+  FILE *f;
+  int i;
+
+  snprintf (path, sizeof path, "/proc/%ld/stat", (long) pid);
+  f = fopen (path, "r");
+  if (f == NULL)
+    return -1;
+  p = fgets (buf, sizeof buf, f);
+  fclose (f);
+  if (p == NULL || (p = strrchr (buf, ')')) == NULL)
+    return -1;
+
+  /* Skip to the 14th field, after the command name.  */
+  for (i = 2; i < 14 && p; i++)
+    p = strchr (p + 1, ' ');
+  if (p == NULL || sscanf (p, "%lu %lu", &utime, &stime) != 2)
+    return -1;
+
+  return (double) (utime + stime) / sysconf (_SC_CLK_TCK);
+}
+
+/* Mount and unmount the directory of the storm ARG at its rate until it
+   is stopped.  */
+static void *
+run_storm (void *arg)
+{
+  struct storm *st = arg;
+  double start = now (), elapsed;
+
+  st->st_events = 0;
+  while (!st->st_stop)
+    {
+      elapsed = now () - start;
+      if (st->st_events >= elapsed * st->st_rate)
+	{
+	  sleep_for (1e-4);
+	  continue;
+	}
+      if (mount ("storm", st->st_dir, "tmpfs", 0, NULL) != 0)
+	break;
+      if (umount2 (st->st_dir, MNT_DETACH) != 0)
+	break;
+      st->st_events += 2;
+    }
+  st->st_time = now () - start;
+
+  return NULL;
+}
+
+/* Mount a tmpfs on the new directory DIR.  Return false on error.  */
+static bool
+mount_tmpfs (char const *dir)
+{
+  return mkdir (dir, 0755) == 0 && mount ("bench", dir, "tmpfs", 0, NULL) == 0;
+}
+
+/* Run a pass of STEP: run COMMAND, then a storm of RATE events per second,
+   if not 0, and remount TARGET readonly.  */
+static void
+run_pass (char const *step, char const *target, unsigned long rate,
+	  char **command)
+{
+  struct storm st;
+  struct rusage usage;
+  pthread_t thread;
+  double idle_cpu, remount, latency;
+  int status = -1;
+  pid_t pid;
+
+  fflush (stdout);
+  pid = fork ();
+  if (pid == 0)
+    {
+      /* The output of the command is not measured.  */
+      if (freopen ("/dev/null", "w", stdout) == NULL)
+	_exit (EXIT_FAILURE);
+      execvp (command[0], command);
+      _exit (127);
+    }
+  if (pid < 0)
+    {
+      perror ("cannot run the command");
+      exit (EXIT_FAILURE);
+    }
+
+  sleep_for (SETTLE_TIME);
+  idle_cpu = cpu_time (pid);
+  sleep_for (IDLE_TIME);
+  idle_cpu = cpu_time (pid) - idle_cpu;
+
+  snprintf (st.st_dir, sizeof st.st_dir, "%s/storm", bench_dir);
+  st.st_rate = rate;
+  st.st_stop = false;
+  st.st_events = 0;
+  st.st_time = 0;
+  if (rate && pthread_create (&thread, NULL, run_storm, &st) != 0)
+    {
+      perror ("cannot start the storm");
+      exit (EXIT_FAILURE);
+    }
+  sleep_for (STORM_TIME);
+
+  remount = now ();
+  if (mount (NULL, target, NULL, MS_REMOUNT | MS_RDONLY, NULL) != 0)
+    {
+      perror (target);
+      exit (EXIT_FAILURE);
+    }
+  while (wait4 (pid, &status, WNOHANG, &usage) == 0)
+    {
+      if (now () - remount > MAX_WAIT)
+	{
+	  kill (pid, SIGKILL);
+	  wait4 (pid, &status, 0, &usage);
+	  break;
+	}
+      sleep_for (1e-4);
+    }
+  latency = now () - remount;
+
+  st.st_stop = true;
+  if (rate)
+    pthread_join (thread, NULL);
+  mount (NULL, target, NULL, MS_REMOUNT, NULL);
+
+  printf ("  %-8s %8.0f events/s %8.2f ms to exit %8.0f ms CPU"
+	  " %6.0f ms idle CPU (exit status %d)\n", step,
+	  st.st_time > 0 ? st.st_events / st.st_time : 0, latency * 1e3,
+	  (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3
+	  + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3,
+	  idle_cpu * 1e3, WIFEXITED (status) ? WEXITSTATUS (status) : -1);
+}
+
+int
+main (int argc, char **argv)
+{
+  char path[sizeof bench_dir + 32], target[sizeof bench_dir + 32];
+  unsigned long n, rate, i;
+  int pass;
+
+  if (argc < 4)
+    {
+      fprintf (stderr, "Usage: %s MOUNTS RATE COMMAND [ARG]...\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  n = strtoul (argv[1], NULL, 10);
+  rate = strtoul (argv[2], NULL, 10);
+
+  /* Nothing is mounted outside of a private mount namespace.  */
+  if (geteuid () != 0 || unshare (CLONE_NEWNS) != 0
+      || mount (NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) != 0)
+    {
+      puts ("bench_watch: skipped, root privileges are required");
+      return EXIT_SUCCESS;
+    }
+
+  if (mkdtemp (bench_dir) == NULL
+      || mount ("bench", bench_dir, "tmpfs", 0, NULL) != 0)
+    {
+      printf ("bench_watch: skipped, cannot mount a tmpfs: %s\n",
+	      strerror (errno));
+      return EXIT_SUCCESS;
+    }
+  snprintf (target, sizeof target, "%s/target", bench_dir);
+  snprintf (path, sizeof path, "%s/storm", bench_dir);
+  if (!mount_tmpfs (target) || mkdir (path, 0755) != 0)
+    {
+      perror (bench_dir);
+      return EXIT_FAILURE;
+    }
+  for (i = 0; i < n; i++)
+    {
+      snprintf (path, sizeof path, "%s/m%lu", bench_dir, i);
+      if (!mount_tmpfs (path))
+	{
+	  perror (path);
+	  return EXIT_FAILURE;
+	}
+    }
+
+  printf ("mount table: %lu mounts, storm of %lu events/s\n", n + 3, rate);
+  for (pass = 0; pass < BENCH_PASSES; pass++)
+    {
+      run_pass ("quiet", target, 0, argv + 3);
+      if (rate)
+	run_pass ("storm", target, rate, argv + 3);
+    }
+
+  return EXIT_SUCCESS;
+}
+
+#else /* !__linux__ */
+
+int
+main (void)
+{
+  puts ("bench_watch: skipped, only supported on GNU/Linux");
+  return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,264 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Generate a synthetic mount table for the benchmarks
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Usage: gen_mounttable [-i|-m] ENTRIES > TABLE
+
+   Write a mount table of about ENTRIES entries, looking like the one of a
+   host running containers: the usual host file systems, followed by the
+   mounts of each container (overlay root, shm, network namespace, secrets
+   on tmpfs, bind-mounted volumes, and NFS persistent volumes).
+
+   The table is written in the mountinfo format (-i), which is the default
+   on GNU/Linux, or in the mtab format (-m), which is the default on the
+   other systems.  The output only depends on ENTRIES, so that the numbers
+   of different releases can be compared.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* A mount to be written.  */
+struct gen_mount
+{
+  char const *devname;
+  char const *mountdir;
+  char const *type;
+  char const *opts;		/* Per-mount options. */
+  char const *super_opts;	/* Super block options. */
+  char const *root;		/* Root of the mount in its file system. */
+};
+
+static char const *const host_mounts[][5] = {
+  /* devname, mount point, type, options, super block options */
+  {"/dev/sda2", "/", "ext4", "rw,relatime", "rw,errors=remount-ro"},
+  {"sysfs", "/sys", "sysfs", "rw,nosuid,nodev,noexec,relatime", "rw"},
+  {"proc", "/proc", "proc", "rw,nosuid,nodev,noexec,relatime", "rw"},
+  {"udev", "/dev", "devtmpfs", "rw,nosuid,relatime",
+   "rw,size=16384000k,nr_inodes=4096000,mode=755,inode64"},
+  {"devpts", "/dev/pts", "devpts", "rw,nosuid,noexec,relatime",
+   "rw,gid=5,mode=620,ptmxmode=000"},
+  {"tmpfs", "/run", "tmpfs", "rw,nosuid,nodev,noexec,relatime",
+   "rw,size=3276800k,mode=755,inode64"},
+  {"securityfs", "/sys/kernel/security", "securityfs",
+   "rw,nosuid,nodev,noexec,relatime", "rw"},
+  {"tmpfs", "/dev/shm", "tmpfs", "rw,nosuid,nodev", "rw,inode64"},
+  {"cgroup2", "/sys/fs/cgroup", "cgroup2", "rw,nosuid,nodev,noexec,relatime",
+   "rw,nsdelegate,memory_recursiveprot"},
+  {"pstore", "/sys/fs/pstore", "pstore", "rw,nosuid,nodev,noexec,relatime",
+   "rw"},
+  {"bpf", "/sys/fs/bpf", "bpf", "rw,nosuid,nodev,noexec,relatime",
+   "rw,mode=700"},
+  {"systemd-1", "/proc/sys/fs/binfmt_misc", "autofs", "rw,relatime",
+   "rw,fd=29,pgrp=1,timeout=0,minproto=5,maxproto=5,direct"},
+  {"mqueue", "/dev/mqueue", "mqueue", "rw,nosuid,nodev,noexec,relatime",
+   "rw"},
+  {"hugetlbfs", "/dev/hugepages", "hugetlbfs", "rw,relatime",
+   "rw,pagesize=2M"},
+  {"debugfs", "/sys/kernel/debug", "debugfs",
+   "rw,nosuid,nodev,noexec,relatime", "rw"},
+  {"tracefs", "/sys/kernel/tracing", "tracefs",
+   "rw,nosuid,nodev,noexec,relatime", "rw"},
+  {"fusectl", "/sys/fs/fuse/connections", "fusectl",
+   "rw,nosuid,nodev,noexec,relatime", "rw"},
+  {"configfs", "/sys/kernel/config", "configfs",
+   "rw,nosuid,nodev,noexec,relatime", "rw"},
+  {"/dev/sda1", "/boot/efi", "vfat", "rw,relatime",
+   "rw,fmask=0077,dmask=0077,codepage=437,iocharset=iso8859-1"},
+  {"/dev/mapper/vg-docker", "/var/lib/docker", "xfs", "rw,relatime",
+   "rw,attr2,inode64,logbufs=8,logbsize=32k,noquota"},
+  {"/dev/mapper/vg-kubelet", "/var/lib/kubelet", "ext4", "rw,relatime",
+   "rw"},
+  {"binfmt_misc", "/proc/sys/fs/binfmt_misc", "binfmt_misc",
+   "rw,nosuid,nodev,noexec,relatime", "rw"},
+  {"tmpfs", "/run/user/1000", "tmpfs", "rw,nosuid,nodev,relatime",
+   "rw,size=3276800k,nr_inodes=819200,mode=700,uid=1000,gid=1000,inode64"},
+  {"nfs01:/export/home", "/home", "nfs4", "rw,relatime",
+   "rw,vers=4.2,rsize=1048576,wsize=1048576,namlen=255,hard,proto=tcp,"
+   "timeo=600,retrans=2,sec=sys,clientaddr=10.0.0.2,local_lock=none,"
+   "addr=10.0.0.1"}
+};
+
+#define N_HOST_MOUNTS (sizeof host_mounts / sizeof host_mounts[0])
+
+/* Number of mounts of each container.  */
+#define CONTAINER_MOUNTS 8
+
+/* Device numbers of the block devices of the table.  The other file
+   systems get an anonymous device number, unique to each mount.  */
+static struct
+{
+  char const *devname;
+  unsigned int major, minor;
+} const block_devices[] = {
+  {"/dev/sda1", 8, 1},
+  {"/dev/sda2", 8, 2},
+  {"/dev/mapper/vg-docker", 253, 0},
+  {"/dev/mapper/vg-kubelet", 253, 1}
+};
+
+static unsigned long next_id;
+static int mountinfo_format;
+
+static void
+put_field (char const *str)
+{
+  /* Escape the blanks and backslashes as the kernel does.  */
+  for (; *str; str++)
+    if (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\\')
+      printf ("\\%03o", (unsigned char) *str);
+    else
+      putchar (*str);
+}
+
+static void
+put_mount (struct gen_mount const *m)
+{
+  if (mountinfo_format)
+    {
+      unsigned long id = next_id++, major = 0, minor = id;
+      size_t i;
+
+      for (i = 0; i < sizeof block_devices / sizeof block_devices[0]; i++)
+	if (strcmp (m->devname, block_devices[i].devname) == 0)
+	  {
+	    major = block_devices[i].major;
+	    minor = block_devices[i].minor;
+	  }
+
+      printf ("%lu %lu %lu:%lu ", id, (id > 21) ? 21UL : 1UL, major, minor);
+      put_field (m->root);
+      putchar (' ');
+      put_field (m->mountdir);
+      printf (" %s shared:%lu - %s ", m->opts, id, m->type);
+      put_field (m->devname);
+      printf (" %s\n", m->super_opts);
+    }
+  else
+    {
+      put_field (m->devname);
+      putchar (' ');
+      put_field (m->mountdir);
+      printf (" %s %s 0 0\n", m->type, m->opts);
+    }
+}
+
+/* Write the mounts of the container number N.  */
+static void
+put_container (unsigned long n, unsigned long entries, unsigned long *count)
+{
+  char id[65], dir[4][256], netns[32], lowerdir[512];
+  char vol[CONTAINER_MOUNTS][320], src[CONTAINER_MOUNTS][256];
+  struct gen_mount m[CONTAINER_MOUNTS];
+  size_t i;
+
+  snprintf (id, sizeof id, "%016lx%016lx%016lx%016lx",
+	    n * 0x9e3779b97f4a7c15UL, n, ~n, n * 2654435761UL);
+
+  snprintf (dir[0], sizeof dir[0], "/var/lib/docker/overlay2/%s/merged", id);
+  snprintf (lowerdir, sizeof lowerdir,
+	    "rw,lowerdir=/var/lib/docker/overlay2/l/%.26s:"
+	    "/var/lib/docker/overlay2/l/%.26s,"
+	    "upperdir=/var/lib/docker/overlay2/%.32s/diff,"
+	    "workdir=/var/lib/docker/overlay2/%.32s/work", id, id + 6, id, id);
+  m[0] = (struct gen_mount) {"overlay", dir[0], "overlay", "rw,relatime",
+			     lowerdir, "/"};
+
+  snprintf (dir[1], sizeof dir[1],
+	    "/var/lib/docker/containers/%s/mounts/shm", id);
+  m[1] = (struct gen_mount) {"shm", dir[1], "tmpfs",
+			     "rw,nosuid,nodev,noexec,relatime",
+			     "rw,size=65536k,inode64", "/"};
+
+  snprintf (dir[2], sizeof dir[2], "/run/docker/netns/%.12s", id);
+  snprintf (netns, sizeof netns, "net:[%lu]", 4026530000UL + n);
+  m[2] = (struct gen_mount) {"nsfs", dir[2], "nsfs", "rw", "rw", netns};
+
+  snprintf (dir[3], sizeof dir[3],
+	    "/var/lib/kubelet/pods/%.8s-%.4s-%.4s/volumes/"
+	    "kubernetes.io~projected/kube-api-access-%.5s",
+	    id, id + 8, id + 12, id + 16);
+  m[3] = (struct gen_mount) {"tmpfs", dir[3], "tmpfs", "rw,relatime",
+			     "rw,size=4194304k,inode64", "/"};
+
+  /* The volumes are bind mounts: inside the container root, and seen by
+     the host with the path of their source in the root field.  */
+  for (i = 4; i < CONTAINER_MOUNTS; i++)
+    {
+      snprintf (vol[i], sizeof vol[i], "%s/data/volume %zu", dir[0], i - 4);
+      if (i == CONTAINER_MOUNTS - 1)
+	{
+	  /* An NFS persistent volume.  */
+	  snprintf (src[i], sizeof src[i], "nfs%02lu:/export/pv-%lu",
+		    n % 7, n);
+	  m[i] = (struct gen_mount) {src[i], vol[i], "nfs4", "rw,relatime",
+				     "rw,vers=4.2,hard,proto=tcp,timeo=600,"
+				     "retrans=2,sec=sys,addr=10.0.1.7", "/"};
+	}
+      else
+	{
+	  /* One container in twenty has read-only volumes.  */
+	  snprintf (src[i], sizeof src[i],
+		    "/var/lib/docker/volumes/%.12s-%zu/_data", id, i);
+	  m[i] = (struct gen_mount) {"/dev/mapper/vg-docker", vol[i], "xfs",
+				     (n % 20 == 19) ? "ro,relatime"
+				     : "rw,relatime", "rw,attr2,inode64",
+				     src[i]};
+	}
+    }
+
+  for (i = 0; i < CONTAINER_MOUNTS && *count < entries; i++, ++*count)
+    put_mount (&m[i]);
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned long entries, count = 0, n;
+  size_t i;
+  char *end;
+
+#ifdef __linux__
+  mountinfo_format = 1;
+#endif
+  if (argc == 3 && strcmp (argv[1], "-i") == 0)
+    mountinfo_format = 1, argv++, argc--;
+  else if (argc == 3 && strcmp (argv[1], "-m") == 0)
+    mountinfo_format = 0, argv++, argc--;
+  if (argc != 2 || (entries = strtoul (argv[1], &end, 10), *end != '\0'))
+    {
+      fprintf (stderr, "Usage: gen_mounttable [-i|-m] ENTRIES\n");
+      return EXIT_FAILURE;
+    }
+
+  next_id = 21;
+  for (i = 0; i < N_HOST_MOUNTS && count < entries; i++, count++)
+    {
+      struct gen_mount m = {
+	host_mounts[i][0], host_mounts[i][1], host_mounts[i][2],
+	host_mounts[i][3], host_mounts[i][4], "/"
+      };
+      put_mount (&m);
+    }
+
+  for (n = 0; count < entries; n++)
+    put_container (n, entries, &count);
+
+  return ferror (stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A classifier of the file system types
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fstype.h"
+#include "xalloc.h"
+
+/* A slot of the table of the known types.  */
+struct fstype_slot
+{
+  char const *fs_name;		/* Type name, or NULL for an unused slot. */
+  size_t fs_len;		/* Length of fs_name. */
+  enum fstype_class fs_class;
+};
+
+/* The perfect hash table generated from fstype.list: every known type is
+   alone in the slot fstype_hash (TYPE, FSTYPE_HASH_SEED) selects.  */
+#include "fstype-table.h"
+
+/* Return true if SLOT holds TYPE, of length LEN.  */
+static bool
+slot_matches (struct fstype_slot const *slot, char const *type, size_t len)
+{
+  return slot->fs_name && slot->fs_len == len
+    && memcmp (slot->fs_name, type, len) == 0;
+}
+
+/* Return the class of TYPE, of length LEN and whose hash value with the
+   seed FSTYPE_HASH_SEED is HASH, according to the generated table.  */
+static enum fstype_class
+lookup_static_type (char const *type, size_t len, unsigned int hash)
+{
+  struct fstype_slot const *slot = &fstype_table[hash & FSTYPE_TABLE_MASK];
+
+  return slot_matches (slot, type, len) ? slot->fs_class : FSTYPE_UNKNOWN;
+}
+
+#ifdef __linux__
+/* The kernel lists the file system types it supports, with the "nodev"
+   marker for those not backed by a block device.  */
+# ifndef PROC_FILESYSTEMS
+#  define PROC_FILESYSTEMS "/proc/filesystems"
+# endif
+
+/* An open-addressing hash table of the types found in PROC_FILESYSTEMS
+   but not in fstype_table, indexed by the same hash values, so that a
+   type missing from both is also found missing in constant time, as with
+   the many FUSE subtypes of some hosts.  */
+static struct fstype_slot *extra_table;
+static size_t extra_mask;
+static size_t n_extra_types;
+static pthread_once_t extra_types_once = PTHREAD_ONCE_INIT;
+
+/* Return the slot of extra_table holding TYPE, of length LEN and whose
+   hash value is HASH, or the free slot where it should be inserted.  */
+static struct fstype_slot *
+find_extra_slot (char const *type, size_t len, unsigned int hash)
+{
+  size_t i = hash & extra_mask;
+
+  while (extra_table[i].fs_name && !slot_matches (&extra_table[i], type, len))
+    i = (i + 1) & extra_mask;
+  return &extra_table[i];
+}
+
+/* Insert the type NAME of class CLASS in extra_table, keeping its load
+   factor under one half.  */
+static void
+insert_extra_type (char const *name, enum fstype_class class)
+{
+  struct fstype_slot *slot;
+  unsigned int hash;
+  size_t i, len;
+
+  if (extra_table == NULL || 2 * (n_extra_types + 1) > extra_mask + 1)
+    {
+      struct fstype_slot *old = extra_table;
+      size_t old_size = old ? extra_mask + 1 : 0;
+
+      extra_mask = old ? 2 * extra_mask + 1 : 15;
+      extra_table = xnmalloc (extra_mask + 1, sizeof *extra_table);
+      memset (extra_table, 0, (extra_mask + 1) * sizeof *extra_table);
+      for (i = 0; i < old_size; i++)
+	if (old[i].fs_name)
+	  *find_extra_slot (old[i].fs_name, old[i].fs_len,
+			    fstype_hash (old[i].fs_name, &len,
+					 FSTYPE_HASH_SEED)) = old[i];
+      free (old);
+    }
+
+  hash = fstype_hash (name, &len, FSTYPE_HASH_SEED);
+  slot = find_extra_slot (name, len, hash);
+  if (slot->fs_name == NULL)
+    {
+      slot->fs_name = xstrdup (name);
+      slot->fs_len = len;
+      slot->fs_class = class;
+      n_extra_types++;
+    }
+}
+
+/* Add to extra_table the types of PROC_FILESYSTEMS missing from the
+   generated table.  Errors are silently ignored.  */
+static void
+load_extra_types (void)
+{
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  FILE *fp;
+
+  if ((fp = fopen (PROC_FILESYSTEMS, "r")) == NULL)
+    return;
+
+  while ((len = getline (&line, &size, fp)) > 0)
+    {
+      char *tab = strchr (line, '\t');
+      unsigned int hash;
+      size_t namelen;
+      char *name;
+
+      if (tab == NULL)
+	continue;
+      name = tab + 1;
+      name[strcspn (name, "\n")] = '\0';
+      hash = fstype_hash (name, &namelen, FSTYPE_HASH_SEED);
+      if (*name == '\0'
+	  || lookup_static_type (name, namelen, hash) != FSTYPE_UNKNOWN)
+	continue;
+
+      insert_extra_type (name,
+			 (tab - line == 5 && strncmp (line, "nodev", 5) == 0)
+			 ? FSTYPE_NODEV : FSTYPE_LOCAL);
+    }
+
+  free (line);
+  fclose (fp);
+}
+#endif /* __linux__ */
+
+/* Return the class of the file system type TYPE.  The types missing from
+   the generated table are looked up, on GNU/Linux, in the table of the
+   types supported by the running kernel, which is read on the first miss.
+   Both tables are indexed by the same hash value, computed once.
+   This function can be called by several threads at once.  */
+enum fstype_class
+fstype_classify (char const *type)
+{
+  size_t len;
+  unsigned int hash = fstype_hash (type, &len, FSTYPE_HASH_SEED);
+  enum fstype_class class = lookup_static_type (type, len, hash);
+
+#ifdef __linux__
+  if (class != FSTYPE_UNKNOWN)
+    return class;
+
+  pthread_once (&extra_types_once, load_extra_types);
+  if (extra_table)
+    class = find_extra_slot (type, len, hash)->fs_class;
+#endif
+
+  return class;
+}
@@ -0,0 +1,42 @@
+#ifndef _FSTYPE_H
+#define _FSTYPE_H        1
+
+# include <stddef.h>
+
+/* Class of a file system type.  */
+enum fstype_class
+{
+  FSTYPE_UNKNOWN,		/* Not a known type. */
+  FSTYPE_LOCAL,			/* Backed by a local block device. */
+  FSTYPE_NODEV,			/* Local, with no backing device (tmpfs). */
+  FSTYPE_PSEUDO,		/* Kernel interface (proc, sysfs, cgroup2). */
+  FSTYPE_DUMMY,			/* Placeholder (autofs, none). */
+  FSTYPE_REMOTE			/* Network file system. */
+};
+
+/* True for the classes of the file systems that hold no data.  */
+# define FSTYPE_IS_DUMMY(Class) \
+    ((Class) == FSTYPE_DUMMY || (Class) == FSTYPE_PSEUDO)
+
+enum fstype_class fstype_classify (char const *type);
+
+/* The hash function of the table of the known types, shared with the
+   program generating it.  Return the hash value of the string NAME with
+   the seed SEED, and store the length of NAME in *LENP.  */
+static inline unsigned int
+fstype_hash (char const *name, size_t *lenp, unsigned int seed)
+{
+  unsigned char const *p = (unsigned char const *) name;
+  unsigned int h = 2166136261U ^ seed;
+
+  while (*p)
+    h = (h ^ *p++) * 16777619U;
+  *lenp = (char const *) p - name;
+
+  h ^= h >> 15;
+  h *= 0x2c1b3c6dU;
+  h ^= h >> 12;
+  return h;
+}
+
+#endif /* fstype.h */
@@ -0,0 +1,261 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Sets of file system types given by name or by glob pattern
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fstype.h"
+#include "fstypeset.h"
+#include "xalloc.h"
+
+#define STREQ(a, b) (strcmp (a, b) == 0)
+
+/* The names of a set are stored in an open-addressing hash table.  The
+   table also remembers whether the patterns of the set match the types
+   already looked up, so that the patterns are run at most once for each
+   distinct type of a mount table.  */
+enum fstype_slot_kind
+{
+  FSS_FREE,			/* Unused slot. */
+  FSS_NAME,			/* A name added to the set. */
+  FSS_MATCH,			/* A type matched by a pattern. */
+  FSS_NOMATCH			/* A type matched by no pattern. */
+};
+
+struct fstype_set_slot
+{
+  char *fss_name;
+  unsigned int fss_hash;
+  enum fstype_slot_kind fss_kind;
+};
+
+/* A glob pattern.  The common patterns whose only wildcard is a trailing
+   '*', like "fuse.*", are matched with a prefix compare.  */
+struct fstype_pattern
+{
+  char *fp_pattern;
+  size_t fp_prefix_len;		/* Length of the prefix before the '*'. */
+  bool fp_prefix_only;		/* True if the pattern is PREFIX*. */
+};
+
+struct fstype_set
+{
+  size_t fs_mask;		/* Number of slots minus one. */
+  size_t fs_used;		/* Number of slots in use. */
+  struct fstype_set_slot *fs_slots;
+  size_t fs_n_names;		/* Number of names added to the set. */
+  struct fstype_pattern *fs_patterns;
+  size_t fs_n_patterns;
+};
+
+/* Return the slot of SET holding NAME, whose hash value is HASH, or the
+   free slot where it should be inserted.  */
+static struct fstype_set_slot *
+find_slot (struct fstype_set const *set, char const *name, unsigned int hash)
+{
+  size_t i = hash & set->fs_mask;
+
+  while (set->fs_slots[i].fss_kind != FSS_FREE
+	 && (set->fs_slots[i].fss_hash != hash
+	     || !STREQ (set->fs_slots[i].fss_name, name)))
+    i = (i + 1) & set->fs_mask;
+
+  return &set->fs_slots[i];
+}
+
+/* Insert NAME in SET with the kind KIND, keeping the load factor of the
+   hash table under one half.  */
+static void
+insert_name (struct fstype_set *set, char const *name, unsigned int hash,
+	     enum fstype_slot_kind kind)
+{
+  struct fstype_set_slot *slot;
+
+  if (2 * (set->fs_used + 1) > set->fs_mask + 1)
+    {
+      struct fstype_set_slot *old = set->fs_slots;
+      size_t i, old_size = set->fs_mask + 1;
+
+      set->fs_mask = 2 * old_size - 1;
+      set->fs_slots = xnmalloc (2 * old_size, sizeof *set->fs_slots);
+      memset (set->fs_slots, 0, 2 * old_size * sizeof *set->fs_slots);
+      for (i = 0; i < old_size; i++)
+	if (old[i].fss_kind != FSS_FREE)
+	  *find_slot (set, old[i].fss_name, old[i].fss_hash) = old[i];
+      free (old);
+    }
+
+  slot = find_slot (set, name, hash);
+  if (slot->fss_kind == FSS_FREE)
+    {
+      slot->fss_name = xstrdup (name);
+      slot->fss_hash = hash;
+      set->fs_used++;
+    }
+  slot->fss_kind = kind;
+}
+
+static bool
+pattern_match (struct fstype_pattern const *fp, char const *type)
+{
+  if (fp->fp_prefix_only)
+    return strncmp (type, fp->fp_pattern, fp->fp_prefix_len) == 0;
+  return fnmatch (fp->fp_pattern, type, 0) == 0;
+}
+
+/* Return a new empty set.  */
+struct fstype_set *
+fstype_set_new (void)
+{
+  struct fstype_set *set = xmalloc (sizeof *set);
+
+  set->fs_mask = 15;
+  set->fs_used = 0;
+  set->fs_n_names = 0;
+  set->fs_slots = xnmalloc (set->fs_mask + 1, sizeof *set->fs_slots);
+  memset (set->fs_slots, 0, (set->fs_mask + 1) * sizeof *set->fs_slots);
+  set->fs_patterns = NULL;
+  set->fs_n_patterns = 0;
+
+  return set;
+}
+
+/* Add to SET the type NAME, which is a glob pattern if it contains any
+   of the wildcards '*', '?' or '['.  */
+void
+fstype_set_add (struct fstype_set *set, char const *name)
+{
+  struct fstype_pattern *fp;
+  char const *wildcard = strpbrk (name, "*?[");
+  size_t i, len;
+
+  if (wildcard == NULL)
+    {
+      unsigned int hash = fstype_hash (name, &len, 0);
+
+      if (find_slot (set, name, hash)->fss_kind != FSS_NAME)
+	{
+	  insert_name (set, name, hash, FSS_NAME);
+	  set->fs_n_names++;
+	}
+      return;
+    }
+
+  for (i = 0; i < set->fs_n_patterns; i++)
+    if (STREQ (set->fs_patterns[i].fp_pattern, name))
+      return;
+
+  set->fs_patterns = xrealloc (set->fs_patterns, (set->fs_n_patterns + 1)
+			       * sizeof *set->fs_patterns);
+  fp = &set->fs_patterns[set->fs_n_patterns++];
+  fp->fp_pattern = xstrdup (name);
+  fp->fp_prefix_len = wildcard - name;
+  fp->fp_prefix_only = (*wildcard == '*' && wildcard[1] == '\0'
+			&& strchr (name, '\\') == NULL);
+
+  /* The types looked up so far might be matched by the new pattern.  */
+  for (i = 0; i <= set->fs_mask; i++)
+    if (set->fs_slots[i].fss_kind == FSS_NOMATCH
+	&& pattern_match (fp, set->fs_slots[i].fss_name))
+      set->fs_slots[i].fss_kind = FSS_MATCH;
+}
+
+/* Return true if SET has neither names nor patterns.  */
+bool
+fstype_set_is_empty (struct fstype_set const *set)
+{
+  return set->fs_n_names == 0 && set->fs_n_patterns == 0;
+}
+
+/* Return true if TYPE is in SET, either by name or because it matches
+   one of the patterns.  The outcome of the patterns is remembered, so
+   that looking up the same type again costs a single hash lookup.  */
+bool
+fstype_set_match (struct fstype_set *set, char const *type)
+{
+  struct fstype_set_slot *slot;
+  unsigned int hash;
+  size_t i, len;
+
+  hash = fstype_hash (type, &len, 0);
+  slot = find_slot (set, type, hash);
+  if (slot->fss_kind != FSS_FREE)
+    return slot->fss_kind != FSS_NOMATCH;
+  if (set->fs_n_patterns == 0)
+    return false;
+
+  for (i = 0; i < set->fs_n_patterns; i++)
+    if (pattern_match (&set->fs_patterns[i], type))
+      break;
+  insert_name (set, type, hash,
+	       (i < set->fs_n_patterns) ? FSS_MATCH : FSS_NOMATCH);
+
+  return i < set->fs_n_patterns;
+}
+
+/* Return a name or a pattern given as is to both SELECTED and EXCLUDED,
+   or NULL if there is none.  A name of SELECTED merely matched by a
+   pattern of EXCLUDED, as with -T ext4 -X 'ext*', is not a conflict: the
+   exclusion wins.  */
+char const *
+fstype_set_conflict (struct fstype_set *selected, struct fstype_set *excluded)
+{
+  size_t i, j;
+
+  for (i = 0; i <= selected->fs_mask; i++)
+    {
+      struct fstype_set_slot const *slot = &selected->fs_slots[i];
+
+      if (slot->fss_kind == FSS_NAME
+	  && find_slot (excluded, slot->fss_name,
+			slot->fss_hash)->fss_kind == FSS_NAME)
+	return slot->fss_name;
+    }
+
+  for (i = 0; i < selected->fs_n_patterns; i++)
+    for (j = 0; j < excluded->fs_n_patterns; j++)
+      if (STREQ (selected->fs_patterns[i].fp_pattern,
+		 excluded->fs_patterns[j].fp_pattern))
+	return selected->fs_patterns[i].fp_pattern;
+
+  return NULL;
+}
+
+/* Release SET.  */
+void
+fstype_set_free (struct fstype_set *set)
+{
+  size_t i;
+
+  if (set == NULL)
+    return;
+
+  for (i = 0; i <= set->fs_mask; i++)
+    if (set->fs_slots[i].fss_kind != FSS_FREE)
+      free (set->fs_slots[i].fss_name);
+  for (i = 0; i < set->fs_n_patterns; i++)
+    free (set->fs_patterns[i].fp_pattern);
+  free (set->fs_slots);
+  free (set->fs_patterns);
+  free (set);
+}
@@ -0,0 +1,17 @@
+#ifndef _FSTYPESET_H
+#define _FSTYPESET_H        1
+
+# include <stdbool.h>
+
+/* A set of file system types, given by name or by glob pattern.  */
+struct fstype_set;
+
+struct fstype_set *fstype_set_new (void);
+void fstype_set_add (struct fstype_set *set, char const *name);
+bool fstype_set_is_empty (struct fstype_set const *set);
+bool fstype_set_match (struct fstype_set *set, char const *type);
+char const *fstype_set_conflict (struct fstype_set *selected,
+				 struct fstype_set *excluded);
+void fstype_set_free (struct fstype_set *set);
+
+#endif /* fstypeset.h */
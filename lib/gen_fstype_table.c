@@ -0,0 +1,185 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Generate the perfect hash table of the known file system types
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Usage: gen_fstype_table LIST > fstype-table.h
+
+   Read the file system types and their classes from LIST (see the format
+   in fstype.list), and search for a seed of fstype_hash that maps every
+   type to its own slot of a power-of-two sized table.  Write the table as
+   a C header, so that looking up a type costs one hash and one compare.  */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fstype.h"
+
+/* Give up a table size after this number of seeds, and double it.  */
+#define MAX_SEEDS (1U << 20)
+
+struct fstype_key
+{
+  char *name;
+  size_t len;
+  char const *class;
+};
+
+static char const *const class_names[][2] = {
+  {"local", "FSTYPE_LOCAL"},
+  {"nodev", "FSTYPE_NODEV"},
+  {"pseudo", "FSTYPE_PSEUDO"},
+  {"dummy", "FSTYPE_DUMMY"},
+  {"remote", "FSTYPE_REMOTE"}
+};
+
+static char const *
+class_enum (char const *name)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof class_names / sizeof class_names[0]; i++)
+    if (strcmp (name, class_names[i][0]) == 0)
+      return class_names[i][1];
+  return NULL;
+}
+
+static void *
+xrealloc_or_die (void *p, size_t size)
+{
+  p = realloc (p, size);
+  if (p == NULL)
+    {
+      perror ("gen_fstype_table");
+      exit (EXIT_FAILURE);
+    }
+  return p;
+}
+
+/* Return true if SEED maps the N keys KEYS to distinct slots of a table
+   of MASK + 1 slots, using USED as a scratch area.  */
+static bool
+try_seed (struct fstype_key const *keys, size_t n, unsigned int seed,
+	  unsigned int mask, unsigned char *used)
+{
+  size_t i, len;
+
+  memset (used, 0, mask + 1);
+  for (i = 0; i < n; i++)
+    {
+      unsigned int slot = fstype_hash (keys[i].name, &len, seed) & mask;
+      if (used[slot])
+	return false;
+      used[slot] = 1;
+    }
+  return true;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct fstype_key *keys = NULL;
+  size_t i, n = 0, alloc = 0, len;
+  unsigned int mask, seed = 0, slot;
+  unsigned char *used;
+  char line[256];
+  long lineno = 0;
+  FILE *fp;
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "Usage: %s LIST\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  if ((fp = fopen (argv[1], "r")) == NULL)
+    {
+      perror (argv[1]);
+      return EXIT_FAILURE;
+    }
+
+  while (fgets (line, sizeof line, fp))
+    {
+      char *name, *class;
+
+      lineno++;
+      name = strtok (line, " \t\n");
+      if (name == NULL || *name == '#')
+	continue;
+      class = strtok (NULL, " \t\n");
+      if (class == NULL || class_enum (class) == NULL)
+	{
+	  fprintf (stderr, "%s:%ld: missing or invalid class\n",
+		   argv[1], lineno);
+	  return EXIT_FAILURE;
+	}
+      for (i = 0; i < n; i++)
+	if (strcmp (keys[i].name, name) == 0)
+	  {
+	    fprintf (stderr, "%s:%ld: duplicate type `%s'\n",
+		     argv[1], lineno, name);
+	    return EXIT_FAILURE;
+	  }
+
+      if (n == alloc)
+	keys = xrealloc_or_die (keys, (alloc = alloc ? 2 * alloc : 64)
+				* sizeof *keys);
+      keys[n].name = strcpy (xrealloc_or_die (NULL, strlen (name) + 1),
+			     name);
+      keys[n].len = strlen (name);
+      keys[n].class = class_enum (class);
+      n++;
+    }
+  fclose (fp);
+
+  /* Start with a load factor of at most one half.  */
+  for (mask = 1; mask + 1 < 2 * n; mask = 2 * mask + 1)
+    ;
+  used = xrealloc_or_die (NULL, mask + 1);
+  for (;;)
+    {
+      for (seed = 0; seed < MAX_SEEDS; seed++)
+	if (try_seed (keys, n, seed, mask, used))
+	  break;
+      if (seed < MAX_SEEDS)
+	break;
+      mask = 2 * mask + 1;
+      used = xrealloc_or_die (used, mask + 1);
+    }
+
+  printf ("/* Generated by gen_fstype_table from %s.  Do not edit.  */\n\n",
+	  strrchr (argv[1], '/') ? strrchr (argv[1], '/') + 1 : argv[1]);
+  printf ("#define FSTYPE_HASH_SEED %uU\n", seed);
+  printf ("#define FSTYPE_TABLE_MASK %uU\n\n", mask);
+  printf ("static struct fstype_slot const fstype_table[%u] = {\n", mask + 1);
+  for (slot = 0; slot <= mask; slot++)
+    {
+      for (i = 0; i < n; i++)
+	if ((fstype_hash (keys[i].name, &len, seed) & mask) == slot)
+	  break;
+      if (i < n)
+	printf ("  {\"%s\", %lu, %s},\n", keys[i].name,
+		(unsigned long) keys[i].len, keys[i].class);
+      else
+	printf ("  {NULL, 0, FSTYPE_UNKNOWN},\n");
+    }
+  printf ("};\n");
+
+  return ferror (stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
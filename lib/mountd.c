@@ -0,0 +1,470 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A resident daemon keeping the table of mounted file systems in memory
+ * and answering the queries of the plugins over a UNIX socket
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The daemon reads the mount table once and then sleeps in poll() until
+   either a client connects or the kernel reports a change of the table.
+   Each query is answered by a child process, which inherits the parsed
+   table and runs the very same code as the plugin.  The client passes its
+   standard output, standard error and working directory along with its
+   command line, so that the output is written straight to the client
+   streams, and gets back the exit status as a single byte.
+   The queries are run with the credentials of the daemon: the socket is
+   only accessible to its owner, and the queries of the other users, but
+   the superuser, are refused.  */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "mountd.h"
+#include "nputils.h"
+#include "xalloc.h"
+
+/* Maximum size of the command line sent by a client.  */
+#define MOUNTD_REQUEST_MAX (64 * 1024)
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+/* Number of descriptors passed by a client: its standard output, its
+   standard error, and its working directory.  */
+#define MOUNTD_NFDS 3
+
+/* The table of mounted file systems held by the daemon, its index, and
+   its compact layout.  */
+static struct mount_entry *mountd_list;
+static struct mount_index *mountd_index;
+static struct mount_table *mountd_table;
+
+/* Descriptors notified of the changes to the mount table.  The first one
+   is polled by the daemon, the second one by the children answering the
+   queries, which may trigger automounts on their own.  */
+static int mountd_watch = -1;
+static int mountd_recheck = -1;
+
+/* True in the child processes answering the queries.  */
+static bool mountd_child;
+
+/* (Re)read the table of mounted file systems.  Keep the old one if the
+   table cannot be read.  Return -1 on error, 0 otherwise.  */
+static int
+load_mount_table (void)
+{
+  struct mount_entry *mount_list;
+
+  if (mountd_watch >= 0)
+    {
+      if (mountd_recheck >= 0)
+	close (mountd_recheck);
+      mountd_recheck = open_mount_table_watch ();
+    }
+
+  /* The queries of any plugin are answered from this table.  */
+  mount_list = read_file_system_list (MOUNT_FIELD_ALL);
+  if (mount_list == NULL)
+    return -1;
+
+  mount_table_free (mountd_table);
+  mount_index_free (mountd_index);
+  free_mount_list (mountd_list);
+  mountd_list = mount_list;
+  mountd_index = mount_index_new (mountd_list);
+  mountd_table = mount_table_new (mountd_list);
+
+  return 0;
+}
+
+/* Return true if a change of the mount table has been notified to FD.  */
+static bool
+mount_table_changed (int fd)
+{
+  struct pollfd pfd;
+
+  if (fd < 0)
+    return false;
+
+  pfd.fd = fd;
+  pfd.events = POLLPRI;
+  return poll (&pfd, 1, 0) > 0 && (pfd.revents & (POLLPRI | POLLERR));
+}
+
+/* Return the table held by the daemon and store its index in *INDEX, if
+   called by a query handler.  The table is read again if it changed in the
+   meantime.  Return NULL otherwise.  */
+struct mount_entry *
+mountd_mount_list (struct mount_index **index)
+{
+  if (!mountd_child)
+    return NULL;
+
+  if (mount_table_changed (mountd_recheck))
+    load_mount_table ();
+
+  *index = mountd_index;
+  return mountd_list;
+}
+
+/* Return the compact layout of the table returned by mountd_mount_list,
+   or NULL if there is none.  */
+struct mount_table *
+mountd_mount_table (void)
+{
+  return mountd_child ? mountd_table : NULL;
+}
+
+/* Return true if the peer of the connection CONN is the superuser or runs
+   with the same user as the daemon.  */
+static bool
+trusted_peer (int conn)
+{
+#ifdef SO_PEERCRED
+  struct ucred cred;
+  socklen_t len = sizeof cred;
+
+  if (getsockopt (conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+    return false;
+  return cred.uid == 0 || cred.uid == geteuid ();
+#else
+  /* Only rely on the mode of the socket.  */
+  (void) conn;
+  return true;
+#endif
+}
+
+/* Return true if called by a query handler.  */
+bool
+mountd_answering (void)
+{
+  return mountd_child;
+}
+
+/* Receive a query on the connection CONN: the descriptors passed by the
+   client are stored in FDS, and the NUL-separated strings of its command
+   line in a newly allocated buffer returned in *REQUEST, of *LEN bytes.
+   Return -1 on error, 0 otherwise.  */
+static int
+receive_query (int conn, int fds[MOUNTD_NFDS], char **request, size_t *len)
+{
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (MOUNTD_NFDS * sizeof (int))];
+  } control;
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  char *buf;
+  ssize_t n;
+
+  buf = xmalloc (MOUNTD_REQUEST_MAX);
+  iov.iov_base = buf;
+  iov.iov_len = MOUNTD_REQUEST_MAX;
+  memset (&msg, 0, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof control.buf;
+
+  n = recvmsg (conn, &msg, 0);
+  cmsg = CMSG_FIRSTHDR (&msg);
+  if (n <= 0 || cmsg == NULL
+      || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+      || cmsg->cmsg_len != CMSG_LEN (MOUNTD_NFDS * sizeof (int)))
+    {
+      free (buf);
+      return -1;
+    }
+  memcpy (fds, CMSG_DATA (cmsg), MOUNTD_NFDS * sizeof (int));
+
+  *len = n;
+  while (*len < MOUNTD_REQUEST_MAX
+	 && (n = read (conn, buf + *len, MOUNTD_REQUEST_MAX - *len)) != 0)
+    {
+      if (n < 0 && errno != EINTR)
+	break;
+      if (n > 0)
+	*len += n;
+    }
+
+  if (*len == 0 || buf[*len - 1] != '\0')
+    {
+      free (buf);
+      return -1;
+    }
+
+  *request = buf;
+  return 0;
+}
+
+/* Answer the query received on the connection CONN by running HANDLER in a
+   child process.  Return the exit status of the calling process.  */
+static int
+answer_query (int conn, mountd_handler handler)
+{
+  int fds[MOUNTD_NFDS];
+  char *request, *arg, **argv;
+  size_t len;
+  int argc, i, status;
+  unsigned char code;
+  pid_t pid;
+
+  if (!trusted_peer (conn) || receive_query (conn, fds, &request, &len) < 0)
+    return EXIT_FAILURE;
+
+  for (argc = 0, arg = request; arg < request + len; arg += strlen (arg) + 1)
+    argc++;
+  argv = xnmalloc (argc + 1, sizeof *argv);
+  for (i = 0, arg = request; i < argc; arg += strlen (arg) + 1)
+    argv[i++] = arg;
+  argv[argc] = NULL;
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      if (dup2 (fds[0], STDOUT_FILENO) < 0
+	  || dup2 (fds[1], STDERR_FILENO) < 0 || fchdir (fds[2]) < 0)
+	_exit (STATE_UNKNOWN);
+      for (i = 0; i < MOUNTD_NFDS; i++)
+	close (fds[i]);
+      close (conn);
+
+      mountd_child = true;
+      exit (handler (argc, argv));
+    }
+
+  code = STATE_UNKNOWN;
+  status = 0;
+  if (pid > 0)
+    {
+      pid_t waited;
+
+      while ((waited = waitpid (pid, &status, 0)) < 0 && errno == EINTR)
+	;
+      if (waited == pid && WIFEXITED (status))
+	code = WEXITSTATUS (status);
+    }
+
+  return write (conn, &code, 1) == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Serve the queries sent to the UNIX socket SOCKET_PATH with HANDLER,
+   holding the table of mounted file systems in memory.  The table is read
+   again only when the kernel reports that it changed, or before each query
+   if such notifications are not supported.
+   This function only returns on error, with errno set.  */
+int
+mountd_serve (char const *socket_path, mountd_handler handler)
+{
+  struct sockaddr_un addr;
+  struct pollfd fds[2];
+  mode_t mask;
+  int sock;
+
+  memset (&addr, 0, sizeof addr);
+  if (strlen (socket_path) >= sizeof addr.sun_path)
+    {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, socket_path);
+
+  sock = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0)
+    return -1;
+  unlink (socket_path);
+
+  /* Create the socket readable and writable by its owner only.  */
+  mask = umask (S_IXUSR | S_IRWXG | S_IRWXO);
+  if (bind (sock, (struct sockaddr *) &addr, sizeof addr) < 0)
+    {
+      int saved_errno = errno;
+      umask (mask);
+      close (sock);
+      errno = saved_errno;
+      return -1;
+    }
+  umask (mask);
+
+  if (listen (sock, SOMAXCONN) < 0)
+    {
+      int saved_errno = errno;
+      close (sock);
+      errno = saved_errno;
+      return -1;
+    }
+
+  mountd_watch = open_mount_table_watch ();
+  if (load_mount_table () < 0)
+    return -1;
+
+  /* Let the kernel reap the children.  */
+  signal (SIGCHLD, SIG_IGN);
+  signal (SIGPIPE, SIG_IGN);
+
+  fds[0].fd = sock;
+  fds[0].events = POLLIN;
+  fds[1].fd = mountd_watch;
+  fds[1].events = POLLPRI;
+
+  for (;;)
+    {
+      int conn;
+
+      if (poll (fds, 2, -1) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return -1;
+	}
+
+      if (fds[1].revents & (POLLPRI | POLLERR))
+	load_mount_table ();
+
+      if (!(fds[0].revents & POLLIN))
+	continue;
+
+      conn = accept (sock, NULL, NULL);
+      if (conn < 0)
+	continue;
+
+      if (mountd_watch < 0)
+	load_mount_table ();
+
+      if (fork () == 0)
+	{
+	  close (sock);
+	  if (mountd_watch >= 0)
+	    close (mountd_watch);
+	  signal (SIGCHLD, SIG_DFL);
+	  signal (SIGPIPE, SIG_DFL);
+	  _exit (answer_query (conn, handler));
+	}
+      close (conn);
+    }
+}
+
+/* Send the command line ARGC, ARGV to the daemon listening on the UNIX
+   socket SOCKET_PATH, and let it write the answer to the standard output
+   and error streams.  Return the exit status sent back by the daemon, or
+   -1 if the daemon cannot be reached or refuses the query, in which case
+   nothing was printed.  */
+int
+mountd_query (char const *socket_path, int argc, char **argv)
+{
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (MOUNTD_NFDS * sizeof (int))];
+  } control;
+  struct sockaddr_un addr;
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct iovec iov;
+  int fds[MOUNTD_NFDS];
+  char *request;
+  size_t len = 0, sent = 0;
+  int sock, i;
+  unsigned char code;
+  ssize_t n;
+
+  memset (&addr, 0, sizeof addr);
+  if (strlen (socket_path) >= sizeof addr.sun_path)
+    return -1;
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, socket_path);
+
+  for (i = 0; i < argc; i++)
+    len += strlen (argv[i]) + 1;
+  if (len > MOUNTD_REQUEST_MAX)
+    return -1;
+
+  sock = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0)
+    return -1;
+  if (connect (sock, (struct sockaddr *) &addr, sizeof addr) < 0
+      || (fds[2] = open (".", O_RDONLY)) < 0)
+    {
+      close (sock);
+      return -1;
+    }
+  fds[0] = STDOUT_FILENO;
+  fds[1] = STDERR_FILENO;
+
+  request = xmalloc (len);
+  for (i = 0, len = 0; i < argc; i++)
+    {
+      size_t arglen = strlen (argv[i]) + 1;
+      memcpy (request + len, argv[i], arglen);
+      len += arglen;
+    }
+
+  iov.iov_base = request;
+  iov.iov_len = len;
+  memset (&msg, 0, sizeof msg);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof control.buf;
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (MOUNTD_NFDS * sizeof (int));
+  memcpy (CMSG_DATA (cmsg), fds, MOUNTD_NFDS * sizeof (int));
+
+  n = sendmsg (sock, &msg, MSG_NOSIGNAL);
+  if (n > 0)
+    for (sent = n; sent < len; sent += n)
+      if ((n = send (sock, request + sent, len - sent, MSG_NOSIGNAL)) <= 0)
+	break;
+  free (request);
+  close (fds[2]);
+
+  if (sent < len)
+    {
+      close (sock);
+      return -1;
+    }
+
+  shutdown (sock, SHUT_WR);
+  while ((n = read (sock, &code, 1)) < 0 && errno == EINTR)
+    ;
+  close (sock);
+
+  /* The daemon closes the connection without answering the queries it
+     refuses.  */
+  if (n == 0)
+    return -1;
+  return n == 1 ? code : STATE_UNKNOWN;
+}
@@ -0,0 +1,20 @@
+#ifndef _MOUNTD_H
+#define _MOUNTD_H        1
+
+# include "mountindex.h"
+# include "mountlist.h"
+# include "mounttable.h"
+
+/* Function run by the daemon, in a child process, to answer a query.
+   ARGC and ARGV are the command line of the client, whose standard output,
+   standard error and working directory are inherited.  Return the exit
+   status to be reported to the client.  */
+typedef int (*mountd_handler) (int argc, char **argv);
+
+int mountd_serve (char const *socket_path, mountd_handler handler);
+int mountd_query (char const *socket_path, int argc, char **argv);
+struct mount_entry *mountd_mount_list (struct mount_index **index);
+struct mount_table *mountd_mount_table (void);
+bool mountd_answering (void);
+
+#endif /* mountd.h */
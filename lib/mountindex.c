@@ -0,0 +1,261 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A hash index over the mount points and devices of a mount list
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mountindex.h"
+#include "xalloc.h"
+
+#define STREQ(a, b) (strcmp (a, b) == 0)
+
+/* The keys the entries are indexed by.  */
+enum mount_index_key
+{
+  MIK_MOUNTDIR,			/* Mount point directory name. */
+  MIK_DEV			/* Device number. */
+};
+
+/* A slot of an open-addressing hash table.  All the entries sharing the
+   same key, like the ones mounted on the same directory (over-mounts), use
+   one slot, and are stored in list order in the array mit_entries,
+   starting at index mis_first.  */
+struct mount_index_slot
+{
+  size_t mis_hash;		/* Hash value of the key. */
+  struct mount_entry *mis_entry; /* First entry with the key. */
+  size_t mis_first;		/* Offset of the entries in mit_entries. */
+  size_t mis_count;		/* Number of entries; zero if unused. */
+};
+
+struct mount_index_table
+{
+  enum mount_index_key mit_key;
+  size_t mit_mask;		/* Number of slots minus one. */
+  struct mount_index_slot *mit_slots;
+  struct mount_entry **mit_entries;
+};
+
+struct mount_index
+{
+  struct mount_index_table mi_mountdirs;
+  struct mount_index_table mi_devs;
+};
+
+/* Return the FNV-1a hash value of the string STR.  */
+static size_t
+hash_string (char const *str)
+{
+  size_t h = (size_t) 2166136261U;
+
+  while (*str)
+    h = (h ^ (unsigned char) *str++) * 16777619U;
+
+  return h;
+}
+
+/* Return the hash value of the key KEY of the entry ME.  */
+static size_t
+hash_key (enum mount_index_key key, struct mount_entry const *me)
+{
+  if (key == MIK_DEV)
+    return (size_t) (((uint64_t) me->me_dev * 0x9e3779b97f4a7c15ULL) >> 32);
+  return hash_string (me->me_mountdir);
+}
+
+/* Return true if the entries A and B have the same key KEY.  */
+static bool
+same_key (enum mount_index_key key, struct mount_entry const *a,
+	  struct mount_entry const *b)
+{
+  if (key == MIK_DEV)
+    return a->me_dev == b->me_dev;
+  return STREQ (a->me_mountdir, b->me_mountdir);
+}
+
+/* Return the slot of TABLE used for the key of ME, whose hash value is
+   HASH.  This is either the slot holding the key, or the empty slot where
+   it should be inserted.  */
+static struct mount_index_slot *
+find_slot (struct mount_index_table const *table,
+	   struct mount_entry const *me, size_t hash)
+{
+  size_t i = hash & table->mit_mask;
+
+  for (;; i = (i + 1) & table->mit_mask)
+    {
+      struct mount_index_slot *slot = &table->mit_slots[i];
+
+      if (slot->mis_count == 0
+	  || (slot->mis_hash == hash
+	      && same_key (table->mit_key, slot->mis_entry, me)))
+	return slot;
+    }
+}
+
+/* Return true if ME has to be indexed in a table by the key KEY.  */
+static bool
+has_key (enum mount_index_key key, struct mount_entry const *me)
+{
+  return key != MIK_DEV || me->me_dev != (dev_t) -1;
+}
+
+/* Fill TABLE with the entries of MOUNT_LIST, made of N entries, by the
+   key KEY.  */
+static void
+table_init (struct mount_index_table *table, enum mount_index_key key,
+	    struct mount_entry *mount_list, size_t n)
+{
+  struct mount_index_slot **entry_slot;
+  struct mount_entry *me;
+  size_t i, size = 16, offset = 0;
+
+  /* Keep the load factor at or below one half.  */
+  while (size < 2 * n)
+    size *= 2;
+
+  table->mit_key = key;
+  table->mit_mask = size - 1;
+  table->mit_slots = xnmalloc (size, sizeof *table->mit_slots);
+  memset (table->mit_slots, 0, size * sizeof *table->mit_slots);
+  table->mit_entries = xnmalloc (n ? n : 1, sizeof *table->mit_entries);
+  entry_slot = xnmalloc (n ? n : 1, sizeof *entry_slot);
+
+  /* First pass: count the entries having each key.  */
+  for (me = mount_list, i = 0; me; me = me->me_next, i++)
+    {
+      size_t hash;
+      struct mount_index_slot *slot;
+
+      if (!has_key (key, me))
+	{
+	  entry_slot[i] = NULL;
+	  continue;
+	}
+      hash = hash_key (key, me);
+      slot = find_slot (table, me, hash);
+      if (slot->mis_count++ == 0)
+	{
+	  slot->mis_hash = hash;
+	  slot->mis_entry = me;
+	}
+      entry_slot[i] = slot;
+    }
+
+  /* Give each used slot its own range of the entry array.  */
+  for (i = 0; i < size; i++)
+    {
+      struct mount_index_slot *slot = &table->mit_slots[i];
+      slot->mis_first = offset;
+      offset += slot->mis_count;
+      slot->mis_count = 0;
+    }
+
+  /* Second pass: fill the ranges, preserving the order of the list.  */
+  for (me = mount_list, i = 0; me; me = me->me_next, i++)
+    {
+      struct mount_index_slot *slot = entry_slot[i];
+      if (slot)
+	table->mit_entries[slot->mis_first + slot->mis_count++] = me;
+    }
+
+  free (entry_slot);
+}
+
+/* Return the entries of TABLE having the same key as ME, in list order,
+   and store their number in *N.  */
+static struct mount_entry **
+table_lookup (struct mount_index_table const *table,
+	      struct mount_entry const *me, size_t *n)
+{
+  struct mount_index_slot *slot =
+    find_slot (table, me, hash_key (table->mit_key, me));
+
+  *n = slot->mis_count;
+  return table->mit_entries + slot->mis_first;
+}
+
+/* Build an index over the mount points and the device numbers of
+   MOUNT_LIST.  The list must not be modified or released while the index
+   is in use.  */
+struct mount_index *
+mount_index_new (struct mount_entry *mount_list)
+{
+  struct mount_index *index;
+  struct mount_entry *me;
+  size_t n = 0;
+
+  for (me = mount_list; me; me = me->me_next)
+    n++;
+
+  index = xmalloc (sizeof *index);
+  table_init (&index->mi_mountdirs, MIK_MOUNTDIR, mount_list, n);
+  table_init (&index->mi_devs, MIK_DEV, mount_list, n);
+
+  return index;
+}
+
+/* Return the entries of the indexed mount list mounted on MOUNTDIR, in
+   list order, and store their number in *N.  */
+struct mount_entry **
+mount_index_lookup (struct mount_index const *index, char const *mountdir,
+		    size_t *n)
+{
+  struct mount_entry key;
+
+  key.me_mountdir = (char *) mountdir;
+  return table_lookup (&index->mi_mountdirs, &key, n);
+}
+
+/* Return the entries of the indexed mount list whose device number is
+   DEV, in list order, and store their number in *N.  There are several
+   of them when a file system is mounted more than once, for instance by
+   bind mounts.  */
+struct mount_entry **
+mount_index_lookup_dev (struct mount_index const *index, dev_t dev,
+			size_t *n)
+{
+  struct mount_entry key;
+
+  if (dev == (dev_t) -1)
+    {
+      *n = 0;
+      return index->mi_devs.mit_entries;
+    }
+  key.me_dev = dev;
+  return table_lookup (&index->mi_devs, &key, n);
+}
+
+/* Release the index INDEX.  */
+void
+mount_index_free (struct mount_index *index)
+{
+  if (index)
+    {
+      free (index->mi_mountdirs.mit_slots);
+      free (index->mi_mountdirs.mit_entries);
+      free (index->mi_devs.mit_slots);
+      free (index->mi_devs.mit_entries);
+      free (index);
+    }
+}
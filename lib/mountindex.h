@@ -0,0 +1,20 @@
+#ifndef _MOUNTINDEX_H
+#define _MOUNTINDEX_H        1
+
+# include <stddef.h>
+# include <sys/types.h>
+
+# include "mountlist.h"
+
+/* A hash index over the mount point directory names and the device
+   numbers of a mount list.  */
+struct mount_index;
+
+struct mount_index *mount_index_new (struct mount_entry *mount_list);
+struct mount_entry **mount_index_lookup (struct mount_index const *index,
+					 char const *mountdir, size_t *n);
+struct mount_entry **mount_index_lookup_dev (struct mount_index const *index,
+					     dev_t dev, size_t *n);
+void mount_index_free (struct mount_index *index);
+
+#endif /* mountindex.h */
@@ -26,12 +26,17 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "fstype.h"
 #include "mountlist.h"
+#include "mountopts.h"
 #include "xalloc.h"
 
 #if HAVE_SYS_PARAM_H
@@ -47,6 +52,35 @@
 # endif
 #endif
 
+#if defined MOUNTED_GETMNTENT1 && defined __linux__
+/* On GNU/Linux the kernel exports the mount table of the calling process
+   in a richer format than the one read by getmntent.  */
+# define MOUNTED_MOUNTINFO 1
+# ifndef MOUNTINFO
+#  define MOUNTINFO "/proc/self/mountinfo"
+# endif
+# if MAJOR_IN_SYSMACROS
+#  include <sys/sysmacros.h>
+# endif
+# include <sys/syscall.h>
+
+/* Since Linux 6.8 the mounts and their attributes can also be read in
+   binary form with the listmount and statmount system calls, with no text
+   to format and parse.  New system calls have the same number on all the
+   architectures but a few, which need the kernel headers to know it.  */
+# if defined __NR_statmount && defined __NR_listmount
+#  define MOUNTED_STATMOUNT 1
+#  define STATMOUNT_NR __NR_statmount
+#  define LISTMOUNT_NR __NR_listmount
+# elif (defined __x86_64__ && !defined __ILP32__) || defined __i386__ \
+  || defined __aarch64__ || defined __arm__ || defined __riscv \
+  || defined __powerpc__ || defined __s390__ || defined __loongarch__
+#  define MOUNTED_STATMOUNT 1
+#  define STATMOUNT_NR 457
+#  define LISTMOUNT_NR 458
+# endif
+#endif
+
 #ifdef MOUNTED_GETMNTENT2	/* SVR4.  */
 # include <sys/mnttab.h>
 #endif
@@ -72,32 +106,166 @@
 # define MNT_IGNORE(M) 0
 #endif
 
+/* The classes of the file system types come from the perfect hash table
+   generated from fstype.list, so that classifying an entry costs a single
+   lookup of its type.  */
 #ifndef ME_DUMMY
-# define ME_DUMMY(Fs_name, Fs_type)             \
-    (strcmp (Fs_type, "autofs") == 0            \
-     || strcmp (Fs_type, "binfmt_misc") == 0    \
-     || strcmp (Fs_type, "devpts") == 0         \
-     || strcmp (Fs_type, "fusectl") == 0        \
-     || strcmp (Fs_type, "none") == 0           \
-     || strcmp (Fs_type, "proc") == 0           \
-     || strcmp (Fs_type, "subfs") == 0          \
-     /* for NetBSD 3.0 */                       \
-     || strcmp (Fs_type, "kernfs") == 0         \
-     /* for Irix 6.5 */                         \
-     || strcmp (Fs_type, "ignore") == 0)
+# define ME_DUMMY(Fs_name, Fs_class) FSTYPE_IS_DUMMY (Fs_class)
 #endif
 
 #ifndef ME_REMOTE
 /* A file system is "remote" if its Fs_name contains a ':'
- *    or if (it is of type (smbfs or cifs) and its Fs_name starts with '//').  */
-# define ME_REMOTE(Fs_name, Fs_type)            \
+ *    or if its type is a network file system.  */
+# define ME_REMOTE(Fs_name, Fs_class)           \
     (strchr (Fs_name, ':') != NULL              \
-     || ((Fs_name)[0] == '/'                    \
-         && (Fs_name)[1] == '/'                 \
-         && (strcmp (Fs_type, "smbfs") == 0     \
-             || strcmp (Fs_type, "cifs") == 0)))
+     || (Fs_class) == FSTYPE_REMOTE)
 #endif
 
+/* The entries of a mount list and the strings they point to are carved
+   out of a chain of large memory blocks (an arena), so that the whole list
+   can be released in one go by free_mount_list.  The first entry of a list
+   is always the first object allocated from the first block of its arena,
+   which is how free_mount_list finds the chain back.  */
+
+struct mount_arena
+{
+  struct mount_arena *ma_next;	/* Next block of the chain. */
+  struct mount_arena *ma_last;	/* Block being carved (first block only). */
+  size_t ma_size;		/* Usable size of this block. */
+  size_t ma_used;		/* Number of bytes already allocated. */
+  void *ma_map;			/* File mapping to be released, if any. */
+  size_t ma_map_size;		/* Size of the file mapping. */
+};
+
+/* Alignment suitable for any object stored in the arena.  */
+union mount_arena_align
+{
+  long double ma_ld;
+  long long int ma_ll;
+  void *ma_ptr;
+};
+
+#define ARENA_ALIGN sizeof (union mount_arena_align)
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+#define ARENA_HEADER_SIZE ARENA_ROUND (sizeof (struct mount_arena))
+#define ARENA_DATA(ma) ((char *) (ma) + ARENA_HEADER_SIZE)
+
+/* Size of the first block of an arena.  Each new block is twice the size
+   of the previous one, up to ARENA_BLOCK_MAX.  */
+#define ARENA_BLOCK_MIN (64 * 1024)
+#define ARENA_BLOCK_MAX (4 * 1024 * 1024)
+
+/* Release all the blocks of the arena ARENA.  */
+static void
+arena_free (struct mount_arena *arena)
+{
+  while (arena)
+    {
+      struct mount_arena *next = arena->ma_next;
+      if (arena->ma_map)
+	munmap (arena->ma_map, arena->ma_map_size);
+      free (arena);
+      arena = next;
+    }
+}
+
+/* Allocate SIZE bytes from the arena *ARENAP, creating the arena if it is
+   still NULL.  If ALIGNED is true, the returned memory is suitably aligned
+   for any object.  */
+static void *
+arena_alloc (struct mount_arena **arenap, size_t size, bool aligned)
+{
+  struct mount_arena *arena = *arenap;
+  struct mount_arena *block = arena ? arena->ma_last : NULL;
+  size_t offset = 0;
+
+  if (block)
+    offset = aligned ? ARENA_ROUND (block->ma_used) : block->ma_used;
+
+  if (!block || block->ma_size - offset < size)
+    {
+      size_t block_size = block ? 2 * block->ma_size : ARENA_BLOCK_MIN;
+
+      if (block_size > ARENA_BLOCK_MAX)
+	block_size = ARENA_BLOCK_MAX;
+      if (block_size < size)
+	block_size = ARENA_ROUND (size);
+
+      block = xmalloc (ARENA_HEADER_SIZE + block_size);
+      block->ma_size = block_size;
+      block->ma_used = 0;
+      block->ma_map = NULL;
+      offset = 0;
+
+      if (arena)
+	{
+	  block->ma_next = arena->ma_last->ma_next;
+	  arena->ma_last->ma_next = block;
+	}
+      else
+	{
+	  block->ma_next = NULL;
+	  *arenap = arena = block;
+	}
+      arena->ma_last = block;
+    }
+
+  block->ma_used = offset + size;
+  return ARENA_DATA (block) + offset;
+}
+
+/* Clone the string STR into the arena *ARENAP.  */
+static char *
+arena_strdup (struct mount_arena **arenap, char const *str)
+{
+  size_t len = strlen (str) + 1;
+  return memcpy (arena_alloc (arenap, len, false), str, len);
+}
+
+/* Clone the string STR into the arena *ARENAP if FIELD is one of the
+   FIELDS asked for, and return NULL otherwise.  If ARENAP is NULL, STR
+   itself is returned.  */
+static char *
+arena_strdup_field (struct mount_arena **arenap, char const *str,
+		    unsigned int fields, unsigned int field)
+{
+  if (!(fields & field))
+    return NULL;
+  return arenap ? arena_strdup (arenap, str) : (char *) str;
+}
+
+/* Allocate a new mount entry from the arena *ARENAP, with all its fields
+   cleared.  */
+static struct mount_entry *
+new_mount_entry (struct mount_arena **arenap)
+{
+  struct mount_entry *me = arena_alloc (arenap, sizeof *me, true);
+  memset (me, 0, sizeof *me);
+  return me;
+}
+
+/* Chain the block BLOCK, allocated and filled by the caller, to the
+   non-empty arena ARENA so that it is released along with it.  No object
+   is ever carved out of BLOCK.  The caller sets the ma_map field.  */
+static void
+arena_link (struct mount_arena *arena, struct mount_arena *block)
+{
+  block->ma_next = arena->ma_next;
+  block->ma_last = NULL;
+  block->ma_size = block->ma_used = 0;
+  arena->ma_next = block;
+}
+
+/* Release the mount list MOUNT_LIST returned by read_file_system_list,
+   along with all the strings its entries point to.  */
+void
+free_mount_list (struct mount_entry *mount_list)
+{
+  if (mount_list)
+    arena_free ((struct mount_arena *) ((char *) mount_list
+					 - ARENA_HEADER_SIZE));
+}
+
 #if MOUNTED_GETMNTINFO
 
 # if ! HAVE_STRUCT_STATFS_F_FSTYPENAME
@@ -242,39 +410,22 @@ static struct opt
   {0, ""}
 };
 
-char *
-catopt(char *s0, const char *s1)
-{
-  size_t i;
-  char *cp;
-
-  if (s0 && *s0)
-    {
-      i = strlen(s0) + strlen(s1) + 1 + 1;
-      if ((cp = malloc(i)) == NULL)
-	err(1, NULL);
-      (void)snprintf(cp, i, "%s,%s", s0, s1);
-    }
-  else
-    cp = strdup(s1);
-
-  free(s0);
-  return (cp);
-}
-
 static char *
-fsp_flags_to_string (u_int32_t f_flags)
+fsp_flags_to_string (struct mount_arena **arenap, u_int32_t f_flags)
 {
-  char *optlist = NULL;
+  char optlist[256];
+  size_t len = 0;
   struct opt *p;
 
+  optlist[0] = '\0';
   for (p = optnames; p->o_opt; p++)
     {
       if (f_flags & p->o_opt && *p->o_optname)
-	optlist = catopt (optlist, p->o_optname);
-    } 
+	len += snprintf (optlist + len, sizeof optlist - len, "%s%s",
+			 len ? "," : "", p->o_optname);
+    }
 
-  return optlist;
+  return arena_strdup (arenap, optlist);
 }
 
 #endif /* MOUNTED_GETMNTINFO */
@@ -293,27 +444,6 @@ fstype_to_string (int t)
 }
 #endif /* MOUNTED_VMOUNT */
 
-/* Check for the "ro" pattern in the MOUNT_OPTIONS.
- *    Return true if found, Otherwise return false.  */
-static bool
-fs_check_if_readonly (char *mount_options)
-{
-  static char const readonly_pattern[] = "ro";
-  char *str1, *token, *saveptr1;
-  int j;
-
-  for (j = 1, str1 = mount_options;; j++, str1 = NULL)
-    {
-      token = strtok_r (str1, ",", &saveptr1);
-      if (token == NULL)
-	break;
-      if (strcmp (token, readonly_pattern) == 0)
-	return true;
-    }
-
-  return false;
-}
-
 #if defined MOUNTED_GETMNTENT1 || defined MOUNTED_GETMNTENT2
 
 /* Return the device number from MOUNT_OPTIONS, if possible.
@@ -349,42 +479,1179 @@ dev_from_mount_options (char const *mount_options)
 
 #endif
 
-/* Return a list of the currently mounted file systems, or NULL on error.
+#ifdef MOUNTED_GETMNTENT1
+
+/* Fill the FIELDS of the entry ME (see read_mount_table) from MNT.  The
+   strings are copied into the arena *ARENAP, or point into MNT if ARENAP
+   is NULL.  */
+static void
+fill_mntent_entry (struct mount_entry *me, struct mntent const *mnt,
+		   unsigned int fields, struct mount_arena **arenap)
+{
+  memset (me, 0, sizeof *me);
+  me->me_devname = arena_strdup_field (arenap, mnt->mnt_fsname,
+				       fields, MOUNT_FIELD_DEVNAME);
+  me->me_mountdir = arena_strdup_field (arenap, mnt->mnt_dir,
+					fields, MOUNT_FIELD_MOUNTDIR);
+  me->me_type = arena_strdup_field (arenap, mnt->mnt_type,
+				    fields, MOUNT_FIELD_TYPE);
+  me->me_opts = arena_strdup_field (arenap, mnt->mnt_opts,
+				    fields, MOUNT_FIELD_OPTS);
+  if (fields & MOUNT_FIELD_CLASS)
+    {
+      me->me_class = fstype_classify (mnt->mnt_type);
+      me->me_dummy = ME_DUMMY (mnt->mnt_fsname, me->me_class);
+      me->me_remote = ME_REMOTE (mnt->mnt_fsname, me->me_class);
+    }
+  if (fields & MOUNT_FIELD_FLAGS)
+    {
+      me->me_flags = mount_options_flags (mnt->mnt_opts);
+      me->me_readonly = (me->me_flags & MOUNT_OPT_RO) != 0;
+    }
+  me->me_dev = (fields & MOUNT_FIELD_DEV)
+    ? dev_from_mount_options (mnt->mnt_opts) : (dev_t) -1;
+}
+
+#endif /* MOUNTED_GETMNTENT1 */
+
+#ifdef MOUNTED_MOUNTINFO
+
+/* Size of the first chunk read from the mountinfo file.  The buffer is
+   doubled every time it fills up.  */
+# define MOUNTINFO_CHUNK (64 * 1024)
+
+# define ISODIGIT(c) ((c) >= '0' && (c) <= '7')
+
+/* Read the whole content of the mountinfo file TABLE into a single
+   NUL-terminated buffer, preceded by room for an arena block header, and
+   store its length in *LEN.  Return NULL on error.  */
+static struct mount_arena *
+read_mountinfo_file (char const *table, size_t *len)
+{
+  size_t size = MOUNTINFO_CHUNK, used = 0;
+  struct mount_arena *buf;
+  int fd;
+
+  fd = open (table, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  buf = xmalloc (ARENA_HEADER_SIZE + size);
+  for (;;)
+    {
+      ssize_t n;
+
+      if (size - used < 2)
+	buf = xrealloc (buf, ARENA_HEADER_SIZE + (size *= 2));
+
+      n = read (fd, ARENA_DATA (buf) + used, size - used - 1);
+      if (n == 0)
+	break;
+      if (n < 0)
+	{
+	  int saved_errno = errno;
+	  if (errno == EINTR)
+	    continue;
+	  free (buf);
+	  close (fd);
+	  errno = saved_errno;
+	  return NULL;
+	}
+      used += n;
+    }
+
+  close (fd);
+  ARENA_DATA (buf)[used] = '\0';
+  buf->ma_map = NULL;
+  *len = used;
+  return buf;
+}
+
+/* Return the next blank-separated field of the mountinfo line pointed to
+   by *LINE and NUL-terminate it in place, then advance *LINE to the field
+   that follows.  The octal escapes used by the kernel for blanks and
+   backslashes ("\040", "\011", "\012", "\134") are decoded in place.
+   Return NULL if there are no fields left.  */
+static char *
+mountinfo_field (char **line)
+{
+  char *src = *line, *dst, *field;
+
+  if (*src == '\0')
+    return NULL;
+
+  field = dst = src;
+  while (*src != '\0' && *src != ' ')
+    {
+      if (src[0] == '\\'
+	  && ISODIGIT (src[1]) && ISODIGIT (src[2]) && ISODIGIT (src[3]))
+	{
+	  *dst++ = ((src[1] - '0') << 6) | ((src[2] - '0') << 3)
+	    | (src[3] - '0');
+	  src += 4;
+	}
+      else
+	*dst++ = *src++;
+    }
+
+  if (*src == ' ')
+    src++;
+  *dst = '\0';
+  *line = src;
+
+  return field;
+}
+
+/* The snapshot cache.
+
+   The classified entries read from the mountinfo file can be saved to a
+   cache file, along with a hash of the raw content of the mountinfo file.
+   As long as the content does not change, the next invocations map the
+   cache file instead of parsing and classifying the table again.
+
+   The snapshot is made of a header, followed by one record per entry, and
+   by the NUL-terminated strings the records point to.  It is written in
+   the native byte order and is not meant to be shared between hosts.  */
+
+# define SNAPSHOT_MAGIC "NPFSSNAP"
+# define SNAPSHOT_VERSION 4
+
+struct mount_snapshot_header
+{
+  char msh_magic[8];		/* SNAPSHOT_MAGIC. */
+  uint32_t msh_version;		/* SNAPSHOT_VERSION. */
+  uint32_t msh_count;		/* Number of records. */
+  uint64_t msh_hash;		/* Hash of the mountinfo content. */
+  uint64_t msh_size;		/* Size of the whole snapshot. */
+};
+
+struct mount_snapshot_record
+{
+  uint32_t msr_devname;		/* Offsets of the strings, counted from */
+  uint32_t msr_mountdir;	/* the end of the last record. */
+  uint32_t msr_type;
+  uint32_t msr_opts;
+  uint64_t msr_dev;
+  uint32_t msr_flags;		/* SNAPSHOT_* flags below. */
+  uint32_t msr_opt_flags;	/* MOUNT_OPT_* bits of the options. */
+};
+
+# define SNAPSHOT_DUMMY    0x1
+# define SNAPSHOT_REMOTE   0x2
+# define SNAPSHOT_READONLY 0x4
+# define SNAPSHOT_CLASS_SHIFT 8	/* The FSTYPE_* class, in bits 8-15. */
+
+/* The cache file, or NULL if no cache is used.  */
+static char const *mount_list_cache;
+
+/* Return a 64-bit hash value of the LEN bytes at BUF.  */
+static uint64_t
+hash_bytes (char const *buf, size_t len)
+{
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+  uint64_t w;
+
+  for (; len >= sizeof w; buf += sizeof w, len -= sizeof w)
+    {
+      memcpy (&w, buf, sizeof w);
+      h = (h ^ w) * 0xff51afd7ed558ccdULL;
+      h ^= h >> 32;
+    }
+  for (; len; len--)
+    h = (h ^ (unsigned char) *buf++) * 0x100000001b3ULL;
+
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+#ifndef O_NOFOLLOW
+# define O_NOFOLLOW 0
+#endif
+
+/* Load the snapshot of the mountinfo content whose hash is HASH from the
+   cache file, if any.  Its entries are appended to the list whose tail
+   pointer is *MTAILP, and point to strings in a private mapping of the
+   cache file that is released along with the arena *ARENAP.  The hash only
+   tells whether the snapshot is current, it does not authenticate it: the
+   cache file is only trusted if it is a regular file, not a symbolic link,
+   owned by the effective user and writable by nobody else, so that no
+   other user can forge the state of the file systems.  Return false if
+   there is no valid snapshot for HASH.  */
+static bool
+load_snapshot (uint64_t hash, struct mount_arena **arenap,
+	       struct mount_entry ***mtailp)
+{
+  struct mount_snapshot_header const *hdr;
+  struct mount_snapshot_record const *rec;
+  struct mount_arena *map_block;
+  struct mount_entry **mtail = *mtailp;
+  struct stat st;
+  char const *strings;
+  size_t strings_size;
+  void *map;
+  uint32_t i;
+  int fd;
+
+  fd = open (mount_list_cache, O_RDONLY | O_NOFOLLOW);
+  if (fd < 0)
+    return false;
+  if (fstat (fd, &st) < 0 || !S_ISREG (st.st_mode)
+      || st.st_uid != geteuid () || (st.st_mode & (S_IWGRP | S_IWOTH))
+      || (size_t) st.st_size < sizeof *hdr)
+    {
+      close (fd);
+      return false;
+    }
+  map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  hdr = map;
+  rec = (struct mount_snapshot_record const *) (hdr + 1);
+  if (memcmp (hdr->msh_magic, SNAPSHOT_MAGIC, sizeof hdr->msh_magic) != 0
+      || hdr->msh_version != SNAPSHOT_VERSION
+      || hdr->msh_hash != hash
+      || hdr->msh_size != (uint64_t) st.st_size
+      || hdr->msh_count == 0
+      || hdr->msh_count > (st.st_size - sizeof *hdr) / sizeof *rec)
+    {
+      munmap (map, st.st_size);
+      return false;
+    }
+  strings = (char const *) (rec + hdr->msh_count);
+  strings_size = (char const *) map + st.st_size - strings;
+
+  /* Check all the offsets before building the list.  The strings area
+     must also end with a NUL byte.  */
+  if (strings_size == 0 || strings[strings_size - 1] != '\0')
+    {
+      munmap (map, st.st_size);
+      return false;
+    }
+  for (i = 0; i < hdr->msh_count; i++)
+    if (rec[i].msr_devname >= strings_size
+	|| rec[i].msr_mountdir >= strings_size
+	|| rec[i].msr_type >= strings_size
+	|| rec[i].msr_opts >= strings_size)
+      {
+	munmap (map, st.st_size);
+	return false;
+      }
+
+  for (i = 0; i < hdr->msh_count; i++, rec++)
+    {
+      struct mount_entry *me = new_mount_entry (arenap);
+
+      me->me_devname = (char *) strings + rec->msr_devname;
+      me->me_mountdir = (char *) strings + rec->msr_mountdir;
+      me->me_type = (char *) strings + rec->msr_type;
+      me->me_opts = (char *) strings + rec->msr_opts;
+      me->me_dev = rec->msr_dev;
+      me->me_flags = rec->msr_opt_flags;
+      me->me_dummy = (rec->msr_flags & SNAPSHOT_DUMMY) != 0;
+      me->me_remote = (rec->msr_flags & SNAPSHOT_REMOTE) != 0;
+      me->me_readonly = (rec->msr_flags & SNAPSHOT_READONLY) != 0;
+      me->me_class = (rec->msr_flags >> SNAPSHOT_CLASS_SHIFT) & 0xff;
+
+      /* Add to the linked list. */
+      *mtail = me;
+      mtail = &me->me_next;
+    }
+
+  map_block = xmalloc (ARENA_HEADER_SIZE);
+  map_block->ma_map = map;
+  map_block->ma_map_size = st.st_size;
+  arena_link (*arenap, map_block);
+
+  *mtailp = mtail;
+  return true;
+}
+
+/* Append the string STR to the strings area STRINGS of *SIZE bytes, of
+   which *USED are in use.  Return its offset.  */
+static uint32_t
+snapshot_string (char **strings, size_t *size, size_t *used,
+		 char const *str)
+{
+  size_t len = strlen (str) + 1;
+  uint32_t offset = *used;
+
+  while (*size - *used < len)
+    *strings = xrealloc (*strings, *size *= 2);
+  memcpy (*strings + *used, str, len);
+  *used += len;
+
+  return offset;
+}
+
+/* Save to the cache file a snapshot of the mount list MOUNT_LIST, built
+   from the mountinfo content whose hash is HASH.  The snapshot is written
+   to a temporary file which is then renamed, so that readers never see a
+   partial snapshot.  Errors are silently ignored.  */
+static void
+save_snapshot (uint64_t hash, struct mount_entry const *mount_list)
+{
+  struct mount_snapshot_header hdr;
+  struct mount_snapshot_record *records;
+  struct mount_entry const *me;
+  size_t count = 0, size = 64 * 1024, used = 0;
+  char *strings, *tmpfile;
+  bool ok;
+  int fd;
+
+  for (me = mount_list; me; me = me->me_next)
+    count++;
+  if (count == 0)
+    return;
+
+  records = xnmalloc (count, sizeof *records);
+  strings = xmalloc (size);
+  for (me = mount_list, count = 0; me; me = me->me_next, count++)
+    {
+      struct mount_snapshot_record *rec = &records[count];
+
+      rec->msr_devname = snapshot_string (&strings, &size, &used,
+					  me->me_devname);
+      rec->msr_mountdir = snapshot_string (&strings, &size, &used,
+					   me->me_mountdir);
+      rec->msr_type = snapshot_string (&strings, &size, &used, me->me_type);
+      rec->msr_opts = snapshot_string (&strings, &size, &used, me->me_opts);
+      rec->msr_dev = me->me_dev;
+      rec->msr_flags = (me->me_dummy ? SNAPSHOT_DUMMY : 0)
+	| (me->me_remote ? SNAPSHOT_REMOTE : 0)
+	| (me->me_readonly ? SNAPSHOT_READONLY : 0)
+	| (me->me_class << SNAPSHOT_CLASS_SHIFT);
+      rec->msr_opt_flags = me->me_flags;
+    }
+
+  memset (&hdr, 0, sizeof hdr);
+  memcpy (hdr.msh_magic, SNAPSHOT_MAGIC, sizeof hdr.msh_magic);
+  hdr.msh_version = SNAPSHOT_VERSION;
+  hdr.msh_count = count;
+  hdr.msh_hash = hash;
+  hdr.msh_size = sizeof hdr + count * sizeof *records + used;
+
+  tmpfile = xmalloc (strlen (mount_list_cache) + sizeof ".XXXXXX");
+  strcpy (tmpfile, mount_list_cache);
+  strcat (tmpfile, ".XXXXXX");
+
+  fd = mkstemp (tmpfile);
+  if (0 <= fd)
+    {
+      ok = (write (fd, &hdr, sizeof hdr) == sizeof hdr
+	    && write (fd, records, count * sizeof *records)
+	       == (ssize_t) (count * sizeof *records)
+	    && write (fd, strings, used) == (ssize_t) used);
+      if (close (fd) != 0 || !ok || rename (tmpfile, mount_list_cache) != 0)
+	unlink (tmpfile);
+    }
+
+  free (tmpfile);
+  free (strings);
+  free (records);
+}
+
+/* Return the device number given by the "MAJOR:MINOR" field of a
+   mountinfo line, or -1 if FIELD is malformed.  */
+static dev_t
+dev_from_mountinfo (char const *field)
+{
+  unsigned long int dev_major, dev_minor;
+  char *end;
+
+  errno = 0;
+  dev_major = strtoul (field, &end, 10);
+  if (end == field || *end != ':' || errno == ERANGE)
+    return -1;
+  field = end + 1;
+  dev_minor = strtoul (field, &end, 10);
+  if (end == field || *end != '\0' || errno == ERANGE)
+    return -1;
+
+  return makedev (dev_major, dev_minor);
+}
+
+/* Skip the next field of the mountinfo line *LINE without decoding it,
+   and return its start, or NULL at the end of the line.  The field is not
+   NUL-terminated.  */
+static char const *
+mountinfo_skip (char **line)
+{
+  char *field = *line;
+
+  if (*field == '\0')
+    return NULL;
+
+  *line = field + strcspn (field, " ");
+  if (**line == ' ')
+    ++*line;
+
+  return field;
+}
+
+/* Move *LINE past its next field, which is decoded and stored in *FIELD
+   if DECODE is true, and skipped otherwise.  Return false at the end of
+   the line.  */
+static bool
+mountinfo_next (char **line, bool decode, char **field)
+{
+  if (decode)
+    return (*field = mountinfo_field (line)) != NULL;
+  return mountinfo_skip (line) != NULL;
+}
+
+/* Parse the mountinfo line LINE, split in place, and fill the FIELDS of
+   the entry ME (see read_mount_table), whose string fields then point
+   into LINE.  Return false if LINE is malformed.
+
+   Each line has the following format (see proc(5)):
+
+   36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+   (1)(2)(3)   (4)   (5)      (6)      (7)   (8) (9)   (10)         (11)
+ */
+static bool
+parse_mountinfo_line (char *line, unsigned int fields, struct mount_entry *me)
+{
+  char *mountdir = NULL, *opts = NULL, *type = NULL, *devname = NULL;
+  char *super_opts = NULL, *dev = NULL;
+  char const *field;
+
+  /* The fields needed to fill the ones asked for.  */
+  bool want_devname =
+    (fields & (MOUNT_FIELD_DEVNAME | MOUNT_FIELD_CLASS)) != 0;
+  bool want_type = (fields & (MOUNT_FIELD_TYPE | MOUNT_FIELD_CLASS)) != 0;
+  bool want_opts = (fields & (MOUNT_FIELD_OPTS | MOUNT_FIELD_FLAGS)) != 0;
+  bool want_super_opts = (fields & MOUNT_FIELD_FLAGS) != 0;
+
+  /* Skip mount ID, parent ID and root, and only decode major:minor,
+     mount point and options if needed.  */
+  if (!mountinfo_skip (&line) || !mountinfo_skip (&line)
+      || !mountinfo_next (&line, fields & MOUNT_FIELD_DEV, &dev)
+      || !mountinfo_skip (&line)
+      || !mountinfo_next (&line, fields & MOUNT_FIELD_MOUNTDIR, &mountdir)
+      || !mountinfo_next (&line, want_opts, &opts))
+    return false;
+
+  /* Skip the optional fields up to the "-" separator.  */
+  while ((field = mountinfo_skip (&line))
+	 && !(field[0] == '-' && (field[1] == ' ' || field[1] == '\0')))
+    ;
+  if (!field
+      || !mountinfo_next (&line, want_type, &type)
+      || !mountinfo_next (&line, want_devname, &devname)
+      || !mountinfo_next (&line, want_super_opts, &super_opts))
+    return false;
+
+  memset (me, 0, sizeof *me);
+  me->me_devname = (fields & MOUNT_FIELD_DEVNAME) ? devname : NULL;
+  me->me_mountdir = mountdir;
+  me->me_type = (fields & MOUNT_FIELD_TYPE) ? type : NULL;
+  me->me_opts = (fields & MOUNT_FIELD_OPTS) ? opts : NULL;
+  if (fields & MOUNT_FIELD_CLASS)
+    {
+      me->me_class = fstype_classify (type);
+      me->me_dummy = ME_DUMMY (devname, me->me_class);
+      me->me_remote = ME_REMOTE (devname, me->me_class);
+    }
+  if (fields & MOUNT_FIELD_FLAGS)
+    {
+      /* Either the mount point or the whole super block can be
+	 readonly.  */
+      me->me_flags = mount_options_flags (opts)
+	| (mount_options_flags (super_opts) & MOUNT_OPT_RO);
+      me->me_readonly = (me->me_flags & MOUNT_OPT_RO) != 0;
+    }
+  me->me_dev = dev ? dev_from_mountinfo (dev) : (dev_t) -1;
+
+  return true;
+}
+
+/* Parse the mountinfo file TABLE and append its entries to the list
+   whose tail pointer is *MTAILP, filling the FIELDS of the entries (see
+   read_mount_table).  The file is read in a single buffer that is split
+   in place, so that the string fields of each entry point into it rather
+   than to separate heap copies; the buffer is then chained to the arena
+   *ARENAP.  If USE_CACHE is true and a cache file is set, its snapshot is
+   used instead when the content of TABLE did not change, and is updated
+   otherwise; all the fields are then filled, to be saved.  Return false
+   if TABLE cannot be read or is not a mountinfo file, in which case the
+   list is left untouched.  */
+static bool
+read_mountinfo (char const *table, unsigned int fields, bool use_cache,
+		struct mount_arena **arenap, struct mount_entry ***mtailp)
+{
+  char const *cache = use_cache ? mount_list_cache : NULL;
+  struct mount_entry **mtail = *mtailp;
+  struct mount_arena *buf;
+  char *line, *next;
+  uint64_t hash = 0;
+  size_t len;
+
+  buf = read_mountinfo_file (table, &len);
+  if (buf == NULL)
+    return false;
+
+  /* Every line of a mountinfo file starts with the mount ID.  */
+  if (len > 0 && !(ARENA_DATA (buf)[0] >= '0' && ARENA_DATA (buf)[0] <= '9'))
+    {
+      free (buf);
+      return false;
+    }
+
+  if (cache)
+    {
+      fields = MOUNT_FIELD_ALL;
+      hash = hash_bytes (ARENA_DATA (buf), len);
+      if (load_snapshot (hash, arenap, mtailp))
+	{
+	  free (buf);
+	  return true;
+	}
+    }
+
+  for (line = ARENA_DATA (buf); *line; line = next)
+    {
+      struct mount_entry entry, *me;
+
+      next = strchr (line, '\n');
+      if (next)
+	*next++ = '\0';
+      else
+	next = line + strlen (line);
+
+      if (!parse_mountinfo_line (line, fields, &entry))
+	continue;
+
+      me = new_mount_entry (arenap);
+      *me = entry;
+
+      /* Add to the linked list. */
+      *mtail = me;
+      mtail = &me->me_next;
+    }
+
+  *mtail = NULL;
+  if (cache)
+    save_snapshot (hash, **mtailp);
+
+  if (*arenap)
+    arena_link (*arenap, buf);
+  else
+    free (buf);
+
+  *mtailp = mtail;
+  return true;
+}
+
+/* Parse the mountinfo file TABLE a line at a time, and pass each entry,
+   with the FIELDS of read_mount_table, to VISIT along with ARG until it
+   returns false.  Only a line is held in memory, so that the memory used
+   does not depend on the size of the table, and the rest of TABLE is not
+   even read once VISIT stops the walk.  Store the result of
+   walk_mount_table in *RESULT and return true, or return false if TABLE
+   cannot be opened or is not a mountinfo file, before any call to
+   VISIT.  */
+static bool
+walk_mountinfo (char const *table, unsigned int fields,
+		mount_entry_visitor visit, void *arg, int *result)
+{
+  char *line = NULL, *buf;
+  size_t size = 0;
+  ssize_t len;
+  bool first = true;
+  int saved_errno = 0;
+  FILE *fp;
+
+  fp = fopen (table, "r");
+  if (fp == NULL)
+    return false;
+
+  /* The buffer of the stream holds as much of the table as the first
+     chunk read by read_mountinfo_file, to make as few reads.  */
+  buf = xmalloc (MOUNTINFO_CHUNK);
+  setvbuf (fp, buf, _IOFBF, MOUNTINFO_CHUNK);
+
+  *result = 0;
+  while (*result == 0 && (len = getline (&line, &size, fp)) > 0)
+    {
+      struct mount_entry me;
+
+      /* Every line of a mountinfo file starts with the mount ID.  */
+      if (first && !(line[0] >= '0' && line[0] <= '9'))
+	{
+	  fclose (fp);
+	  free (buf);
+	  free (line);
+	  return false;
+	}
+      first = false;
+
+      if (line[len - 1] == '\n')
+	line[len - 1] = '\0';
+      if (parse_mountinfo_line (line, fields, &me) && !visit (&me, arg))
+	*result = 1;
+    }
+
+  if ((ferror (fp) | fclose (fp)) != 0 && *result == 0)
+    {
+      saved_errno = errno;
+      *result = -1;
+    }
+  free (buf);
+  free (line);
+  errno = saved_errno;
+  return true;
+}
+
+# ifdef MOUNTED_STATMOUNT
+
+/* The structures of the listmount and statmount system calls, as in
+   <linux/mount.h>, which might be older than the running kernel.  */
+struct kernel_mnt_id_req
+{
+  uint32_t size;		/* Size of the request. */
+  uint32_t spare;
+  uint64_t mnt_id;		/* Mount to be queried, or LSMT_ROOT. */
+  uint64_t param;		/* Attributes, or last mount listed. */
+};
+
+struct kernel_statmount
+{
+  uint32_t size;		/* Total size, including the strings. */
+  uint32_t mnt_opts;		/* [str] Options of the file system. */
+  uint64_t mask;		/* Attributes actually returned. */
+  uint32_t sb_dev_major;	/* Device number of the file system. */
+  uint32_t sb_dev_minor;
+  uint64_t sb_magic;
+  uint32_t sb_flags;		/* SB_* flags of the super block. */
+  uint32_t fs_type;		/* [str] Type of the file system. */
+  uint64_t mnt_id;
+  uint64_t mnt_parent_id;
+  uint32_t mnt_id_old;		/* ID shown in the mountinfo file. */
+  uint32_t mnt_parent_id_old;
+  uint64_t mnt_attr;		/* MOUNT_ATTR_* flags of the mount. */
+  uint64_t mnt_propagation;
+  uint64_t mnt_peer_group;
+  uint64_t mnt_master;
+  uint64_t propagate_from;
+  uint32_t mnt_root;		/* [str] Root of the mount in the fs. */
+  uint32_t mnt_point;		/* [str] Mount point. */
+  uint64_t mnt_ns_id;
+  uint32_t fs_subtype;		/* [str] Subtype of the file system. */
+  uint32_t sb_source;		/* [str] Source of the mount. */
+  uint32_t opt_num;
+  uint32_t opt_array;
+  uint32_t opt_sec_num;
+  uint32_t opt_sec_array;
+  uint64_t supported_mask;	/* Attributes known to the kernel. */
+  uint32_t mnt_uidmap_num;
+  uint32_t mnt_uidmap;
+  uint32_t mnt_gidmap_num;
+  uint32_t mnt_gidmap;
+  uint64_t spare2[43];
+  char str[];			/* The [str] fields are offsets in here. */
+};
+
+/* The attributes returned by statmount.  */
+#  define SM_SB_BASIC		0x0001
+#  define SM_MNT_BASIC		0x0002
+#  define SM_MNT_POINT		0x0010
+#  define SM_FS_TYPE		0x0020
+#  define SM_FS_SUBTYPE		0x0100	/* Linux 6.15. */
+#  define SM_SB_SOURCE		0x0200	/* Linux 6.15. */
+#  define SM_SUPPORTED_MASK	0x1000	/* Linux 6.15. */
+
+/* The attributes returned since Linux 6.8.  */
+#  define SM_BASE (SM_SB_BASIC | SM_MNT_BASIC | SM_MNT_POINT | SM_FS_TYPE)
+
+/* List all the mounts reachable from the root directory.  */
+#  define LSMT_ROOT 0xffffffffffffffffULL
+
+/* The flags of the mounts and of the super blocks.  */
+#  define SM_ATTR_RDONLY	0x000001
+#  define SM_ATTR_NOSUID	0x000002
+#  define SM_ATTR_NODEV		0x000004
+#  define SM_ATTR_NOEXEC	0x000008
+#  define SM_ATTR_ATIME		0x000070
+#  define SM_ATTR_RELATIME	0x000000
+#  define SM_ATTR_NOATIME	0x000010
+#  define SM_ATTR_NODIRATIME	0x000080
+#  define SM_ATTR_IDMAP		0x100000
+#  define SM_ATTR_NOSYMFOLLOW	0x200000
+#  define SM_SB_RDONLY		0x000001
+
+/* Number of mount IDs returned by each listmount call.  */
+#  define LISTMOUNT_BATCH 512
+
+/* The unique mount ID returned by statx since Linux 6.8, to be passed to
+   statmount, rather than the old one, which is reused.  */
+#  ifndef STATX_MNT_ID_UNIQUE
+#   define STATX_MNT_ID_UNIQUE 0x4000U
+#  endif
+
+/* The buffers of a walk of the mounts with statmount.  */
+struct statmount_walk
+{
+  struct kernel_statmount *sw_buf; /* Result of the last statmount. */
+  size_t sw_size;		/* Size of sw_buf. */
+  char *sw_type;		/* Type and subtype, joined by a dot. */
+  size_t sw_type_size;
+  char sw_opts[96];		/* Options of the mount, as in mountinfo. */
+};
+
+/* Return the statmount attributes needed to fill FIELDS.  */
+static uint64_t
+statmount_mask (unsigned int fields)
+{
+  uint64_t mask = 0;
+
+  if (fields & MOUNT_FIELD_MOUNTDIR)
+    mask |= SM_MNT_POINT;
+  if (fields & (MOUNT_FIELD_DEV | MOUNT_FIELD_FLAGS))
+    mask |= SM_SB_BASIC;
+  if (fields & (MOUNT_FIELD_OPTS | MOUNT_FIELD_FLAGS))
+    mask |= SM_MNT_BASIC;
+  if (fields & (MOUNT_FIELD_TYPE | MOUNT_FIELD_CLASS))
+    mask |= SM_FS_TYPE | SM_FS_SUBTYPE;
+  if (fields & (MOUNT_FIELD_DEVNAME | MOUNT_FIELD_CLASS))
+    mask |= SM_SB_SOURCE;
+
+  return mask;
+}
+
+/* Query the attributes MASK of the mount ID into the buffer of W, which
+   is enlarged as needed.  Return false and set errno on error.  */
+static bool
+do_statmount (struct statmount_walk *w, uint64_t id, uint64_t mask)
+{
+  struct kernel_mnt_id_req req;
+
+  memset (&req, 0, sizeof req);
+  req.size = sizeof req;
+  req.mnt_id = id;
+  req.param = mask;
+
+  while (syscall (STATMOUNT_NR, &req, w->sw_buf, w->sw_size, 0) != 0)
+    {
+      if (errno != EOVERFLOW)
+	return false;
+      w->sw_buf = xrealloc (w->sw_buf, w->sw_size *= 2);
+    }
+
+  return true;
+}
+
+/* Return the options of a mount whose MOUNT_ATTR_* flags are ATTR, written
+   in BUF as in the mountinfo file.  */
+static char *
+statmount_options (char *buf, uint64_t attr)
+{
+  strcpy (buf, (attr & SM_ATTR_RDONLY) ? "ro" : "rw");
+  if (attr & SM_ATTR_NOSUID)
+    strcat (buf, ",nosuid");
+  if (attr & SM_ATTR_NODEV)
+    strcat (buf, ",nodev");
+  if (attr & SM_ATTR_NOEXEC)
+    strcat (buf, ",noexec");
+  if ((attr & SM_ATTR_ATIME) == SM_ATTR_NOATIME)
+    strcat (buf, ",noatime");
+  if (attr & SM_ATTR_NODIRATIME)
+    strcat (buf, ",nodiratime");
+  if ((attr & SM_ATTR_ATIME) == SM_ATTR_RELATIME)
+    strcat (buf, ",relatime");
+  if (attr & SM_ATTR_NOSYMFOLLOW)
+    strcat (buf, ",nosymfollow");
+  if (attr & SM_ATTR_IDMAP)
+    strcat (buf, ",idmapped");
+
+  return buf;
+}
+
+/* Return the MOUNT_OPT_* flags of a mount whose MOUNT_ATTR_* flags are
+   ATTR, and the SB_* flags of whose file system are SB_FLAGS, as read
+   from the mountinfo file.  */
+static unsigned int
+statmount_flags (uint64_t attr, uint32_t sb_flags)
+{
+  unsigned int flags = (attr & SM_ATTR_RDONLY) ? MOUNT_OPT_RO : MOUNT_OPT_RW;
+
+  if (attr & SM_ATTR_NOSUID)
+    flags |= MOUNT_OPT_NOSUID;
+  if (attr & SM_ATTR_NODEV)
+    flags |= MOUNT_OPT_NODEV;
+  if (attr & SM_ATTR_NOEXEC)
+    flags |= MOUNT_OPT_NOEXEC;
+  if ((attr & SM_ATTR_ATIME) == SM_ATTR_NOATIME)
+    flags |= MOUNT_OPT_NOATIME;
+  if ((attr & SM_ATTR_ATIME) == SM_ATTR_RELATIME)
+    flags |= MOUNT_OPT_RELATIME;
+  if (attr & SM_ATTR_NODIRATIME)
+    flags |= MOUNT_OPT_NODIRATIME;
+
+  /* Either the mount point or the whole super block can be readonly.  */
+  if (sb_flags & SM_SB_RDONLY)
+    flags |= MOUNT_OPT_RO;
+
+  return flags;
+}
+
+/* Fill the FIELDS of the entry ME (see read_mount_table) from the result
+   of the last statmount of W, for the mount ID.  The strings point into
+   the buffers of W.  No statmount is needed if only MOUNT_FIELD_ID is
+   asked for.  */
+static void
+fill_statmount_entry (struct mount_entry *me, struct statmount_walk *w,
+		      uint64_t id, unsigned int fields)
+{
+  struct kernel_statmount const *sm = w->sw_buf;
+  char *type = NULL, *devname = "none";
+
+  if (sm->mask & SM_SB_SOURCE)
+    devname = (char *) sm->str + sm->sb_source;
+  if (sm->mask & SM_FS_TYPE)
+    {
+      type = (char *) sm->str + sm->fs_type;
+      if (sm->mask & SM_FS_SUBTYPE)
+	{
+	  char const *subtype = sm->str + sm->fs_subtype;
+	  size_t size = strlen (type) + strlen (subtype) + 2;
+
+	  if (w->sw_type_size < size)
+	    w->sw_type = xrealloc (w->sw_type, w->sw_type_size = size);
+	  sprintf (w->sw_type, "%s.%s", type, subtype);
+	  type = w->sw_type;
+	}
+    }
+
+  memset (me, 0, sizeof *me);
+  me->me_devname = (fields & MOUNT_FIELD_DEVNAME) ? devname : NULL;
+  me->me_mountdir = (fields & MOUNT_FIELD_MOUNTDIR)
+    ? (char *) sm->str + sm->mnt_point : NULL;
+  me->me_type = (fields & MOUNT_FIELD_TYPE) ? type : NULL;
+  me->me_opts = (fields & MOUNT_FIELD_OPTS)
+    ? statmount_options (w->sw_opts, sm->mnt_attr) : NULL;
+  if (fields & MOUNT_FIELD_CLASS)
+    {
+      me->me_class = fstype_classify (type);
+      me->me_dummy = ME_DUMMY (devname, me->me_class);
+      me->me_remote = ME_REMOTE (devname, me->me_class);
+    }
+  if (fields & MOUNT_FIELD_FLAGS)
+    {
+      me->me_flags = statmount_flags (sm->mnt_attr, sm->sb_flags);
+      me->me_readonly = (me->me_flags & MOUNT_OPT_RO) != 0;
+    }
+  me->me_dev = (fields & MOUNT_FIELD_DEV)
+    ? makedev (sm->sb_dev_major, sm->sb_dev_minor) : (dev_t) -1;
+  me->me_mnt_id = (fields & MOUNT_FIELD_ID) ? id : 0;
+}
+
+/* Return true if the result of the last statmount of W, asked for the
+   attributes MASK and for the supported ones, shows that the kernel
+   returns all of them.  */
+static bool
+statmount_supported (struct statmount_walk const *w, uint64_t mask)
+{
+  struct kernel_statmount const *sm = w->sw_buf;
+
+  if ((mask & ~SM_BASE) == 0)
+    return true;
+  return (sm->mask & SM_SUPPORTED_MASK)
+    && (sm->supported_mask & mask) == mask;
+}
+
+/* Return a copy of the entry ENTRY, whose FIELDS are filled, allocated
+   with its strings from the arena *ARENAP.  */
+static struct mount_entry *
+copy_mount_entry (struct mount_arena **arenap, struct mount_entry const *entry,
+		  unsigned int fields)
+{
+  struct mount_entry *me = new_mount_entry (arenap);
+
+  *me = *entry;
+  me->me_devname = arena_strdup_field (arenap, entry->me_devname,
+				       fields, MOUNT_FIELD_DEVNAME);
+  me->me_mountdir = arena_strdup_field (arenap, entry->me_mountdir,
+					fields, MOUNT_FIELD_MOUNTDIR);
+  me->me_type = arena_strdup_field (arenap, entry->me_type,
+				    fields, MOUNT_FIELD_TYPE);
+  me->me_opts = arena_strdup_field (arenap, entry->me_opts,
+				    fields, MOUNT_FIELD_OPTS);
+
+  return me;
+}
+
+static void
+statmount_walk_init (struct statmount_walk *w)
+{
+  w->sw_size = 4096;
+  w->sw_buf = xmalloc (w->sw_size);
+  w->sw_buf->mask = 0;
+  w->sw_type = NULL;
+  w->sw_type_size = 0;
+}
+
+static void
+statmount_walk_free (struct statmount_walk *w)
+{
+  free (w->sw_buf);
+  free (w->sw_type);
+}
+
+/* Walk the mounts reachable from the root directory with listmount and
+   statmount, asking only for the attributes needed to fill FIELDS (see
+   read_mount_table).  Each entry is either passed to VISIT along with
+   ARG, until VISIT returns false, with strings only valid during the
+   call, or if VISIT is NULL appended to the list whose tail pointer is
+   *MTAILP, with strings copied into the arena *ARENAP.  Store the result
+   of walk_mount_table in *RESULT and return true, or return false if the
+   system calls are not supported or do not return all the attributes
+   needed, before any call to VISIT and without appending any entry.  */
+static bool
+walk_statmount (unsigned int fields, mount_entry_visitor visit, void *arg,
+		struct mount_arena **arenap, struct mount_entry ***mtailp,
+		int *result)
+{
+  uint64_t mask = statmount_mask (fields), last = 0;
+  uint64_t ids[LISTMOUNT_BATCH];
+  struct statmount_walk w;
+  bool first = true;
+  long n, i;
+
+  statmount_walk_init (&w);
+  *result = 0;
+
+  do
+    {
+      struct kernel_mnt_id_req req;
+
+      memset (&req, 0, sizeof req);
+      req.size = sizeof req;
+      req.mnt_id = LSMT_ROOT;
+      req.param = last;
+      n = syscall (LISTMOUNT_NR, &req, ids, (size_t) LISTMOUNT_BATCH, 0);
+      if (n < 0 || (first && n == 0))
+	goto fail;
+
+      for (i = 0; i < n && *result == 0; i++)
+	{
+	  struct mount_entry entry, *me;
+
+	  last = ids[i];
+	  if (mask != 0)
+	    {
+	      if (!do_statmount (&w, ids[i],
+				 first ? mask | SM_SUPPORTED_MASK : mask))
+		{
+		  /* Unmounted since it was listed.  */
+		  if (!first && errno == ENOENT)
+		    continue;
+		  goto fail;
+		}
+	      if (first && !statmount_supported (&w, mask))
+		goto fail;
+	    }
+	  first = false;
+	  fill_statmount_entry (&entry, &w, ids[i], fields);
+
+	  if (visit)
+	    {
+	      if (!visit (&entry, arg))
+		*result = 1;
+	      continue;
+	    }
+
+	  me = copy_mount_entry (arenap, &entry, fields);
+
+	  /* Add to the linked list. */
+	  **mtailp = me;
+	  *mtailp = &me->me_next;
+	}
+    }
+  while (n == LISTMOUNT_BATCH && *result == 0);
+
+  statmount_walk_free (&w);
+  return true;
+
+fail:
+  statmount_walk_free (&w);
+  if (first)
+    return false;
+
+  /* The list of the mounts changed under our feet: a mount listed could
+     not be queried, or the next batch could not be listed.  */
+  *result = -1;
+  return true;
+}
+
+/* Append the mounts reachable from the root directory to the list whose
+   tail pointer is *MTAILP, with strings in the arena *ARENAP, reading
+   them with listmount and statmount.  Return false if this is not
+   supported, or if the walk failed, in which case the arena and the list
+   are left empty.  */
+static bool
+read_statmount (unsigned int fields, struct mount_arena **arenap,
+		struct mount_entry ***mtailp)
+{
+  struct mount_entry **mtail = *mtailp;
+  int result;
+
+  if (!walk_statmount (fields, NULL, NULL, arenap, &mtail, &result))
+    return false;
+  if (result < 0)
+    {
+      arena_free (*arenap);
+      *arenap = NULL;
+      return false;
+    }
+
+  *mtailp = mtail;
+  return true;
+}
+
+# endif /* MOUNTED_STATMOUNT */
+
+/* Append the entries of the mountinfo file TABLE, or of the system table
+   if TABLE is NULL, to the list whose tail pointer is *MTAILP, as
+   read_mountinfo.  The system table is read with statmount or from the
+   mountinfo file, the other one being tried if the first fails, so that
+   it can also be read without /proc.  Statmount is the only way to get
+   the mount IDs, but is slower than the parsing of the mountinfo file
+   otherwise.  The cache only holds the system table, without the mount
+   IDs.  Return false if the table cannot be read.  */
+static bool
+read_kernel_table (char const *table, unsigned int fields,
+		   struct mount_arena **arenap, struct mount_entry ***mtailp)
+{
+# ifdef MOUNTED_STATMOUNT
+  bool first = (table == NULL && (fields & MOUNT_FIELD_ID)
+		&& mount_list_cache == NULL);
+
+  if (first && read_statmount (fields, arenap, mtailp))
+    return true;
+# endif
+  if (read_mountinfo (table ? table : MOUNTINFO, fields, table == NULL,
+		      arenap, mtailp))
+    return true;
+# ifdef MOUNTED_STATMOUNT
+  if (table == NULL && !first && read_statmount (fields, arenap, mtailp))
+    return true;
+# endif
+
+  return false;
+}
+
+/* Walk the mountinfo file TABLE, or the system table if TABLE is NULL,
+   as walk_mountinfo, with the backends of read_kernel_table.  */
+static bool
+walk_kernel_table (char const *table, unsigned int fields,
+		   mount_entry_visitor visit, void *arg, int *result)
+{
+# ifdef MOUNTED_STATMOUNT
+  bool first = (table == NULL && (fields & MOUNT_FIELD_ID));
+
+  if (first && walk_statmount (fields, visit, arg, NULL, NULL, result))
+    return true;
+# endif
+  if (walk_mountinfo (table ? table : MOUNTINFO, fields, visit, arg, result))
+    return true;
+# ifdef MOUNTED_STATMOUNT
+  if (table == NULL && !first
+      && walk_statmount (fields, visit, arg, NULL, NULL, result))
+    return true;
+# endif
+
+  return false;
+}
+
+#endif /* MOUNTED_MOUNTINFO */
+
+/* Use the cache file FILE to save a snapshot of the classified mount table
+   and reuse it while the table does not change.  This is only supported
+   when reading the GNU/Linux mountinfo file, and is a no-op otherwise.
+   A NULL FILE disables the cache.  */
+
+void
+set_mount_list_cache (char const *file)
+{
+#ifdef MOUNTED_MOUNTINFO
+  mount_list_cache = file;
+#else
+  (void) file;
+#endif
+}
+
+/* Return a file descriptor that can be passed to poll() to be notified of
+   changes to the table of mounted file systems: POLLPRI and POLLERR are
+   reported each time a file system is mounted or unmounted.
+   Return -1 and set errno if such notifications are not supported.  */
+
+int
+open_mount_table_watch (void)
+{
+#ifdef MOUNTED_MOUNTINFO
+  return open (MOUNTINFO, O_RDONLY);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/* Return the list of the file systems listed in the mount table file
+   TABLE, or NULL on error.  TABLE must be in the format of the mount table
+   of the system: /proc/self/mountinfo or /etc/mtab on GNU/Linux, /etc/mtab
+   on the other systems using getmntent, /etc/mnttab on SVR4.  If TABLE is
+   NULL, read the table of the currently mounted file systems.  The systems
+   which have no mount table file only support a NULL TABLE, and set errno
+   to ENOTSUP otherwise.
    Add each entry to the tail of the list so that they stay in order.
-   If NEED_FS_TYPE is true, ensure that the file system type fields in
-   the returned list are valid.  Otherwise, they might not be.  */
+   FIELDS is a mask of the MOUNT_FIELD_* fields of the entries the caller
+   uses: the other ones are neither decoded nor copied, and the
+   classification of the types is skipped unless MOUNT_FIELD_CLASS is
+   given.
+   On GNU/Linux 6.8 and later the system table can also be read with the
+   listmount and statmount system calls, when the kernel returns all the
+   attributes needed: they are used if MOUNT_FIELD_ID is given and no cache
+   is set, and if /proc cannot be read.  */
 
 struct mount_entry *
-read_file_system_list (bool need_fs_type)
+read_mount_table (char const *table, unsigned int fields)
 {
   struct mount_entry *mount_list;
   struct mount_entry *me;
   struct mount_entry **mtail = &mount_list;
-  (void) need_fs_type;
+  struct mount_arena *arena = NULL;
+
+#if defined MOUNTED_GETMNTINFO || defined MOUNTED_VMOUNT
+  if (table)
+    {
+      errno = ENOTSUP;
+      return NULL;
+    }
+#endif
 
 #ifdef MOUNTED_GETMNTENT1	/* GNU/Linux, 4.3BSD, SunOS, HP-UX, Dynix, Irix.  */
+# ifdef MOUNTED_MOUNTINFO
+  /* Fall back to getmntent if /proc is not available, or if TABLE is not
+     in the mountinfo format.  */
+  if (!read_kernel_table (table, fields, &arena, &mtail))
+# endif
   {
     struct mntent *mnt;
-    char const *table = MOUNTED;
+    char const *mtab = table ? table : MOUNTED;
     FILE *fp;
 
-    fp = setmntent (table, "r");
+    fp = setmntent (mtab, "r");
     if (fp == NULL)
       return NULL;
 
     while ((mnt = getmntent (fp)))
       {
-	me = xmalloc (sizeof *me);
-	me->me_devname = xstrdup (mnt->mnt_fsname);
-	me->me_mountdir = xstrdup (mnt->mnt_dir);
-	me->me_type = xstrdup (mnt->mnt_type);
-	me->me_type_malloced = 1;
-	me->me_opts = xstrdup (mnt->mnt_opts);
-	me->me_opts_malloced = 1;
-	me->me_dummy = ME_DUMMY (me->me_devname, me->me_type);
-	me->me_remote = ME_REMOTE (me->me_devname, me->me_type);
-	me->me_readonly = fs_check_if_readonly (me->me_opts);
-	me->me_dev = dev_from_mount_options (mnt->mnt_opts);
+	me = new_mount_entry (&arena);
+	fill_mntent_entry (me, mnt, fields, &arena);
 
 	/* Add to the linked list. */
 	*mtail = me;
@@ -399,7 +1666,7 @@ read_file_system_list (bool need_fs_type)
 #ifdef MOUNTED_GETMNTENT2	/* SVR4.  */
   {
     struct mnttab mnt;
-    char *table = MNTTAB;
+    char const *mnttab = table ? table : MNTTAB;
     FILE *fp;
     int ret;
     int lockfd = -1;
@@ -434,24 +1701,35 @@ read_file_system_list (bool need_fs_type)
 # endif
 
     errno = 0;
-    fp = fopen (table, "r");
+    fp = fopen (mnttab, "r");
     if (fp == NULL)
       ret = errno;
     else
       {
 	while ((ret = getmntent (fp, &mnt)) == 0)
 	  {
-	    me = xmalloc (sizeof *me);
-	    me->me_devname = xstrdup (mnt.mnt_special);
-	    me->me_mountdir = xstrdup (mnt.mnt_mountp);
-	    me->me_type = xstrdup (mnt.mnt_fstype);
-	    me->me_type_malloced = 1;
-	    me->me_opts = xstrdup (mnt.mnt_mntopts);
-	    me->me_opts_malloced = 1;
-	    me->me_dummy = MNT_IGNORE (&mnt) != 0;
-	    me->me_remote = ME_REMOTE (me->me_devname, me->me_type);
-	    me->me_readonly = fs_check_if_readonly (me->me_opts);
-	    me->me_dev = dev_from_mount_options (mnt.mnt_mntopts);
+	    me = new_mount_entry (&arena);
+	    me->me_devname = arena_strdup_field (&arena, mnt.mnt_special,
+						 fields, MOUNT_FIELD_DEVNAME);
+	    me->me_mountdir = arena_strdup_field (&arena, mnt.mnt_mountp,
+						  fields, MOUNT_FIELD_MOUNTDIR);
+	    me->me_type = arena_strdup_field (&arena, mnt.mnt_fstype,
+					      fields, MOUNT_FIELD_TYPE);
+	    me->me_opts = arena_strdup_field (&arena, mnt.mnt_mntopts,
+					      fields, MOUNT_FIELD_OPTS);
+	    if (fields & MOUNT_FIELD_CLASS)
+	      {
+		me->me_class = fstype_classify (mnt.mnt_fstype);
+		me->me_dummy = MNT_IGNORE (&mnt) != 0;
+		me->me_remote = ME_REMOTE (mnt.mnt_special, me->me_class);
+	      }
+	    if (fields & MOUNT_FIELD_FLAGS)
+	      {
+		me->me_flags = mount_options_flags (mnt.mnt_mntopts);
+		me->me_readonly = (me->me_flags & MOUNT_OPT_RO) != 0;
+	      }
+	    me->me_dev = (fields & MOUNT_FIELD_DEV)
+	      ? dev_from_mount_options (mnt.mnt_mntopts) : (dev_t) -1;
 
 	    /* Add to the linked list. */
 	    *mtail = me;
@@ -484,16 +1762,27 @@ read_file_system_list (bool need_fs_type)
       {
         char *fs_type = fsp_to_string (fsp);
 
-        me = xmalloc (sizeof *me);
-        me->me_devname = xstrdup (fsp->f_mntfromname);
-        me->me_mountdir = xstrdup (fsp->f_mntonname);
-        me->me_type = fs_type;
-        me->me_type_malloced = 0;
-        me->me_opts = fsp_flags_to_string (fsp->f_flags);
-        me->me_opts_malloced = 1;
-        me->me_dummy = ME_DUMMY (me->me_devname, me->me_type);
-        me->me_remote = ME_REMOTE (me->me_devname, me->me_type);
-        me->me_readonly = (fsp->f_flags & MNT_RDONLY);
+        me = new_mount_entry (&arena);
+        me->me_devname = arena_strdup_field (&arena, fsp->f_mntfromname,
+                                             fields, MOUNT_FIELD_DEVNAME);
+        me->me_mountdir = arena_strdup_field (&arena, fsp->f_mntonname,
+                                              fields, MOUNT_FIELD_MOUNTDIR);
+        me->me_type = (fields & MOUNT_FIELD_TYPE) ? fs_type : NULL;
+        if (fields & (MOUNT_FIELD_OPTS | MOUNT_FIELD_FLAGS))
+          me->me_opts = fsp_flags_to_string (&arena, fsp->f_flags);
+        if (fields & MOUNT_FIELD_CLASS)
+          {
+            me->me_class = fstype_classify (fs_type);
+            me->me_dummy = ME_DUMMY (fsp->f_mntfromname, me->me_class);
+            me->me_remote = ME_REMOTE (fsp->f_mntfromname, me->me_class);
+          }
+        if (fields & MOUNT_FIELD_FLAGS)
+          {
+            me->me_flags = mount_options_flags (me->me_opts);
+            me->me_readonly = (fsp->f_flags & MNT_RDONLY);
+          }
+        if (!(fields & MOUNT_FIELD_OPTS))
+          me->me_opts = NULL;
         me->me_dev = (dev_t) -1;        /* Magic; means not known yet. */
 
         /* Add to the linked list. */
@@ -533,38 +1822,51 @@ read_file_system_list (bool need_fs_type)
         char *options, *ignore;
 
         vmp = (struct vmount *) thisent;
-        me = xmalloc (sizeof *me);
-        if (vmp->vmt_flags & MNT_REMOTE)
+        me = new_mount_entry (&arena);
+        if (!(fields & MOUNT_FIELD_DEVNAME))
+          me->me_devname = NULL;
+        else if (vmp->vmt_flags & MNT_REMOTE)
           {
             char *host, *dir;
 
-            me->me_remote = 1;
             /* Prepend the remote dirname.  */
             host = thisent + vmp->vmt_data[VMT_HOSTNAME].vmt_off;
             dir = thisent + vmp->vmt_data[VMT_OBJECT].vmt_off;
-            me->me_devname = xmalloc (strlen (host) + strlen (dir) + 2);
+            me->me_devname = arena_alloc (&arena,
+                                          strlen (host) + strlen (dir) + 2,
+                                          false);
             strcpy (me->me_devname, host);
             strcat (me->me_devname, ":");
             strcat (me->me_devname, dir);
           }
         else
+          me->me_devname = arena_strdup (&arena, thisent +
+                                         vmp->vmt_data[VMT_OBJECT].vmt_off);
+        me->me_mountdir = arena_strdup_field (&arena, thisent +
+                                              vmp->vmt_data[VMT_STUB].vmt_off,
+                                              fields, MOUNT_FIELD_MOUNTDIR);
+        me->me_type = arena_strdup_field (&arena,
+                                          fstype_to_string (vmp->vmt_gfstype),
+                                          fields, MOUNT_FIELD_TYPE);
+        options = thisent + vmp->vmt_data[VMT_ARGS].vmt_off;
+        me->me_opts = arena_strdup_field (&arena, options,
+                                          fields, MOUNT_FIELD_OPTS);
+        if (fields & MOUNT_FIELD_CLASS)
           {
-            me->me_remote = 0;
-            me->me_devname = xstrdup (thisent +
-                                      vmp->vmt_data[VMT_OBJECT].vmt_off);
+            me->me_class =
+              fstype_classify (fstype_to_string (vmp->vmt_gfstype));
+            me->me_remote = (vmp->vmt_flags & MNT_REMOTE) != 0;
+            ignore = strstr (options, "ignore");
+            me->me_dummy = (ignore
+                            && (ignore == options || ignore[-1] == ',')
+                            && (ignore[sizeof "ignore" - 1] == ','
+                                || ignore[sizeof "ignore" - 1] == '\0'));
+          }
+        if (fields & MOUNT_FIELD_FLAGS)
+          {
+            me->me_flags = mount_options_flags (options);
+            me->me_readonly = (me->me_flags & MOUNT_OPT_RO) != 0;
           }
-        me->me_mountdir = xstrdup (thisent + vmp->vmt_data[VMT_STUB].vmt_off);
-        me->me_type = xstrdup (fstype_to_string (vmp->vmt_gfstype));
-        me->me_type_malloced = 1;
-        options = thisent + vmp->vmt_data[VMT_ARGS].vmt_off;
-        me->me_opts = xstrdup (options);
-        me->me_opts_malloced = 1;
-        ignore = strstr (options, "ignore");
-        me->me_dummy = (ignore
-                        && (ignore == options || ignore[-1] == ',')
-                        && (ignore[sizeof "ignore" - 1] == ','
-                            || ignore[sizeof "ignore" - 1] == '\0'));
-        me->me_readonly = fs_check_if_readonly (me->me_opts);
         me->me_dev = (dev_t) -1; /* vmt_fsid might be the info we want.  */
 
         /* Add to the linked list. */
@@ -576,28 +1878,243 @@ read_file_system_list (bool need_fs_type)
 #endif /* AIX.  */
 
   *mtail = NULL;
+  if (mount_list == NULL)
+    arena_free (arena);
   return mount_list;
 
 
 free_then_fail:
   {
     int saved_errno = errno;
-    *mtail = NULL;
 
-    while (mount_list)
-      {
-	me = mount_list->me_next;
-	free (mount_list->me_devname);
-	free (mount_list->me_mountdir);
-	if (mount_list->me_type_malloced)
-	  free (mount_list->me_type);
-	if (mount_list->me_opts_malloced)
-	  free (mount_list->me_opts);
-	free (mount_list);
-	mount_list = me;
-      }
+    arena_free (arena);
 
     errno = saved_errno;
     return NULL;
   }
 }
+
+/* Return a list of the currently mounted file systems, or NULL on error.
+   See read_mount_table.  */
+
+struct mount_entry *
+read_file_system_list (unsigned int fields)
+{
+  return read_mount_table (NULL, fields);
+}
+
+/* Pass each entry of the mount table file TABLE, with the FIELDS of
+   read_mount_table, to VISIT along with ARG, in the order of the table,
+   until VISIT returns false.  The entry and its strings are only valid
+   during the call to VISIT, and its me_next field is meaningless.
+   TABLE is as for read_mount_table, but the cache is never used.
+   On GNU/Linux and the other systems using getmntent the table is read
+   an entry at a time, so that the memory used does not depend on its
+   size, and the rest of it is not read once VISIT stops the walk; on the
+   other systems the whole list is read first.
+   Return 1 if VISIT stopped the walk, 0 if all the entries were visited,
+   or -1 and set errno if the table cannot be read.  */
+
+int
+walk_mount_table (char const *table, unsigned int fields,
+		  mount_entry_visitor visit, void *arg)
+{
+  int result = 0;
+#ifdef MOUNTED_GETMNTENT1
+  struct mntent *mnt;
+  FILE *fp;
+
+# ifdef MOUNTED_MOUNTINFO
+  if (walk_kernel_table (table, fields, visit, arg, &result))
+    return result;
+# endif
+
+  fp = setmntent (table ? table : MOUNTED, "r");
+  if (fp == NULL)
+    return -1;
+
+  while (result == 0 && (mnt = getmntent (fp)))
+    {
+      struct mount_entry me;
+
+      fill_mntent_entry (&me, mnt, fields, NULL);
+      if (!visit (&me, arg))
+	result = 1;
+    }
+
+  if (endmntent (fp) == 0)
+    return -1;
+#else
+  struct mount_entry *mount_list, *me;
+
+  mount_list = read_mount_table (table, fields);
+  if (mount_list == NULL)
+    return -1;
+
+  for (me = mount_list; me; me = me->me_next)
+    if (!visit (me, arg))
+      {
+	result = 1;
+	break;
+      }
+
+  free_mount_list (mount_list);
+#endif
+
+  return result;
+}
+
+/* Walk the currently mounted file systems.  See walk_mount_table.  */
+
+int
+walk_file_system_list (unsigned int fields, mount_entry_visitor visit,
+		       void *arg)
+{
+  return walk_mount_table (NULL, fields, visit, arg);
+}
+
+/* Return a list holding the entries of the N mounts whose unique IDs are
+   IDS (see me_mnt_id), in the same order, with the FIELDS of
+   read_mount_table, to be released with free_mount_list.  Only these
+   mounts are queried, with a statmount call each, whatever the size of
+   the table.  Return NULL and set errno if any of them cannot be read, to
+   ENOSYS if statmount is not supported and to ENOENT if there is no such
+   mount.  */
+
+struct mount_entry *
+read_mount_entries (uint64_t const *ids, size_t n, unsigned int fields)
+{
+#ifdef MOUNTED_STATMOUNT
+  uint64_t mask = statmount_mask (fields);
+  struct mount_arena *arena = NULL;
+  struct mount_entry *mount_list = NULL, **mtail = &mount_list;
+  struct statmount_walk w;
+  int saved_errno = 0;
+  size_t i;
+
+  if (n == 0)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  statmount_walk_init (&w);
+  for (i = 0; i < n; i++)
+    {
+      struct mount_entry entry, *me;
+
+      if (!do_statmount (&w, ids[i], i == 0 ? mask | SM_SUPPORTED_MASK : mask))
+	{
+	  saved_errno = errno;
+	  break;
+	}
+      if (i == 0 && !statmount_supported (&w, mask))
+	{
+	  saved_errno = ENOSYS;
+	  break;
+	}
+      fill_statmount_entry (&entry, &w, ids[i], fields);
+      me = copy_mount_entry (&arena, &entry, fields);
+
+      /* Add to the linked list. */
+      *mtail = me;
+      mtail = &me->me_next;
+    }
+  *mtail = NULL;
+  statmount_walk_free (&w);
+
+  if (saved_errno != 0)
+    {
+      arena_free (arena);
+      errno = saved_errno;
+      return NULL;
+    }
+  return mount_list;
+#else
+  (void) ids;
+  (void) n;
+  (void) fields;
+  errno = ENOSYS;
+  return NULL;
+#endif
+}
+
+/* Return a list holding the entry of the mount whose unique ID is ID, as
+   read_mount_entries.  */
+
+struct mount_entry *
+read_mount_entry (uint64_t id, unsigned int fields)
+{
+  return read_mount_entries (&id, 1, fields);
+}
+
+/* Store in *ROOT whether FILE is the root directory of a mount, and in
+   *ID the ID of the mount holding it, which identifies it among the
+   current mounts but may be reused after it is unmounted.  FILE is
+   followed if it is a symbolic link and FOLLOW is true, but it is never
+   automounted.  Only the file itself is looked at, not the mount table,
+   so that the cost does not depend on its size.  Return 0 on success, or
+   -1 and set errno on error, to ENOSYS if this is not supported, as
+   before Linux 5.8.  */
+
+int
+file_mount_state (char const *file, bool follow, bool *root, uint64_t *id)
+{
+#if defined __linux__ && defined STATX_MNT_ID && defined STATX_ATTR_MOUNT_ROOT
+  struct statx stx;
+
+  if (statx (AT_FDCWD, file,
+	     AT_NO_AUTOMOUNT | (follow ? 0 : AT_SYMLINK_NOFOLLOW),
+	     STATX_MNT_ID, &stx) != 0)
+    return -1;
+  if (!(stx.stx_mask & STATX_MNT_ID)
+      || !(stx.stx_attributes_mask & STATX_ATTR_MOUNT_ROOT))
+    {
+      errno = ENOSYS;
+      return -1;
+    }
+
+  *root = (stx.stx_attributes & STATX_ATTR_MOUNT_ROOT) != 0;
+  *id = stx.stx_mnt_id;
+  return 0;
+#else
+  (void) file;
+  (void) follow;
+  (void) root;
+  (void) id;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+/* Store in *ID the unique ID of the mount holding FILE, or the file open
+   on FD if FILE is NULL, as found in me_mnt_id.  FILE is not automounted
+   if it is an automount point.  Return 0 on success, or -1 and set errno
+   on error, to ENOSYS if the unique mount IDs are not supported.  */
+
+int
+file_mount_id (int fd, char const *file, uint64_t *id)
+{
+#if defined MOUNTED_STATMOUNT && defined STATX_MNT_ID
+  struct statx stx;
+
+  if (statx (file ? AT_FDCWD : fd, file ? file : "",
+	     file ? AT_NO_AUTOMOUNT : AT_EMPTY_PATH, STATX_MNT_ID_UNIQUE,
+	     &stx) != 0)
+    return -1;
+  if (!(stx.stx_mask & STATX_MNT_ID_UNIQUE))
+    {
+      errno = ENOSYS;
+      return -1;
+    }
+
+  *id = stx.stx_mnt_id;
+  return 0;
+#else
+  (void) fd;
+  (void) file;
+  (void) id;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
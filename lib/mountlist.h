@@ -2,6 +2,8 @@
 #define _MOUNTLIST_H        1
 
 # include <stdbool.h>
+# include <stddef.h>
+# include <stdint.h>
 # include <sys/types.h>
 
 /* A mount table entry. */
@@ -12,14 +14,50 @@ struct mount_entry
   char *me_type;                /* "nfs", "4.2", etc. */
   char *me_opts;                /* Comma-separated options for fs. */
   dev_t me_dev;                 /* Device number of me_mountdir. */
+  uint64_t me_mnt_id;           /* Unique mount ID, or 0 if unknown. */
+  unsigned int me_flags;        /* MOUNT_OPT_* bits of me_opts. */
   unsigned int me_dummy : 1;    /* Nonzero for dummy file systems. */
   unsigned int me_remote : 1;   /* Nonzero for remote fileystems. */
   unsigned int me_readonly : 1; /* Nonzero for readonly fileystems. */
-  unsigned int me_type_malloced : 1; /* Nonzero if me_type was malloced. */
-  unsigned int me_opts_malloced : 1; /* Nonzero if me_opts was malloced. */
+  unsigned int me_unknown : 1;  /* Nonzero if the state is unknown. */
+  unsigned int me_class : 3;    /* FSTYPE_* class of me_type. */
   struct mount_entry *me_next;
 };
 
-struct mount_entry *read_file_system_list (bool need_fs_type);
+/* The fields of the entries to be filled by read_mount_table.  The string
+   fields not asked for are NULL, me_dev is -1, and the other ones are
+   zero.  */
+enum mount_field
+{
+  MOUNT_FIELD_DEVNAME = 1 << 0,	/* me_devname. */
+  MOUNT_FIELD_MOUNTDIR = 1 << 1, /* me_mountdir. */
+  MOUNT_FIELD_TYPE = 1 << 2,	/* me_type. */
+  MOUNT_FIELD_OPTS = 1 << 3,	/* me_opts. */
+  MOUNT_FIELD_DEV = 1 << 4,	/* me_dev. */
+  MOUNT_FIELD_FLAGS = 1 << 5,	/* me_flags and me_readonly. */
+  MOUNT_FIELD_CLASS = 1 << 6,	/* me_class, me_dummy and me_remote. */
+  MOUNT_FIELD_ID = 1 << 7,	/* me_mnt_id. */
+  MOUNT_FIELD_ALL = (1 << 8) - 1
+};
+
+/* A function called by walk_mount_table for each entry ME, with the
+   argument ARG given to it.  Return false to stop the walk.  */
+typedef bool (*mount_entry_visitor) (struct mount_entry *me, void *arg);
+
+struct mount_entry *read_file_system_list (unsigned int fields);
+struct mount_entry *read_mount_table (char const *table, unsigned int fields);
+struct mount_entry *read_mount_entry (uint64_t id, unsigned int fields);
+struct mount_entry *read_mount_entries (uint64_t const *ids, size_t n,
+				       unsigned int fields);
+int file_mount_id (int fd, char const *file, uint64_t *id);
+int file_mount_state (char const *file, bool follow, bool *root,
+		      uint64_t *id);
+int walk_file_system_list (unsigned int fields, mount_entry_visitor visit,
+			   void *arg);
+int walk_mount_table (char const *table, unsigned int fields,
+		      mount_entry_visitor visit, void *arg);
+void free_mount_list (struct mount_entry *mount_list);
+int open_mount_table_watch (void);
+void set_mount_list_cache (char const *file);
 
 #endif /* mountlist.h */
@@ -0,0 +1,303 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Read the mount tables of all the mount namespaces
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Each container has its own mount namespace, whose mounts are not seen
+   in the mount table of the host.  On GNU/Linux the mount table of any
+   process can be read from /proc/PID/mountinfo, and the namespace of a
+   process is identified by the device and inode numbers of
+   /proc/PID/ns/mnt.  All the processes are scanned, but the table of each
+   namespace is read only once, from the process of the namespace with the
+   lowest PID.  If this process exits before its table is read, the table
+   is read from another process found in the namespace by scanning /proc
+   again.  The tables are read and parsed concurrently by a pool of
+   threads.  */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+# include <dirent.h>
+# include <sys/stat.h>
+#endif
+
+#include "mountns.h"
+#include "probe.h"
+#include "xalloc.h"
+
+#ifdef __linux__
+
+/* The reading of the mount table of a namespace.  */
+struct mount_namespace_probe
+{
+  dev_t mnp_dev;
+  ino_t mnp_ino;
+  pid_t mnp_pid;
+  unsigned int mnp_fields;
+  struct mount_entry *mnp_list;
+  bool mnp_unreadable;
+};
+
+/* Return true if the process PID is in the mount namespace identified by
+   DEV and INO.  */
+static bool
+in_namespace (pid_t pid, dev_t dev, ino_t ino)
+{
+  char path[64];
+  struct stat st;
+
+  snprintf (path, sizeof path, "/proc/%ld/ns/mnt", (long) pid);
+  return stat (path, &st) == 0 && st.st_dev == dev && st.st_ino == ino;
+}
+
+/* Return the lowest PID greater than AFTER of the processes in the mount
+   namespace identified by DEV and INO, or -1 if there is none.  */
+static pid_t
+find_namespace_pid (dev_t dev, ino_t ino, pid_t after)
+{
+  struct dirent *de;
+  pid_t found = -1;
+  DIR *dir;
+
+  dir = opendir ("/proc");
+  if (dir == NULL)
+    return -1;
+
+  while ((de = readdir (dir)) != NULL)
+    {
+      char *end;
+      long pid = strtol (de->d_name, &end, 10);
+
+      if (end == de->d_name || *end != '\0' || pid <= after
+	  || (found > 0 && pid >= found))
+	continue;
+      if (in_namespace (pid, dev, ino))
+	found = pid;
+    }
+
+  closedir (dir);
+  return found;
+}
+
+/* Read the mount table of a namespace from one of its processes.  The
+   table read is only kept if the process is still in the namespace
+   afterwards, as its PID may have been reused in the meantime.  If it is
+   not, another process of the namespace is looked for.  The namespace is
+   flagged as unreadable if its table cannot be read from a process that
+   is still in it.  */
+static void
+read_namespace (void *arg)
+{
+  struct mount_namespace_probe *mnp = arg;
+  struct mount_entry *list;
+  char path[64];
+
+  while (mnp->mnp_pid > 0)
+    {
+      snprintf (path, sizeof path, "/proc/%ld/mountinfo",
+		(long) mnp->mnp_pid);
+      list = read_mount_table (path, mnp->mnp_fields);
+      if (in_namespace (mnp->mnp_pid, mnp->mnp_dev, mnp->mnp_ino))
+	{
+	  mnp->mnp_list = list;
+	  mnp->mnp_unreadable = (list == NULL);
+	  return;
+	}
+      free_mount_list (list);
+      mnp->mnp_pid = find_namespace_pid (mnp->mnp_dev, mnp->mnp_ino,
+					 mnp->mnp_pid);
+    }
+}
+
+static size_t
+hash_id (dev_t dev, ino_t ino, size_t mask)
+{
+  uint64_t id = (uint64_t) ino ^ ((uint64_t) dev << 32 | (uint64_t) dev >> 32);
+
+  return (size_t) ((id * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+}
+
+static int
+compare_pids (void const *a, void const *b)
+{
+  pid_t pa = ((struct mount_namespace const *) a)->mn_pid;
+  pid_t pb = ((struct mount_namespace const *) b)->mn_pid;
+
+  return (pa > pb) - (pa < pb);
+}
+
+/* Scan /proc and return an array of the distinct mount namespaces of the
+   processes, sorted by PID, and store their number in *N.  The mount list
+   of each namespace, with the FIELDS of read_mount_table, is read by
+   WORKERS concurrent threads.  A namespace
+   whose list could not be read within TIMEOUT seconds is flagged as timed
+   out, and one whose list could not be read from a process still in it is
+   flagged as unreadable.  A namespace whose processes all exited has a
+   NULL list.  Return NULL and set errno if /proc cannot be read.  */
+struct mount_namespace *
+read_mount_namespaces (size_t *n, unsigned int fields, unsigned int workers,
+		       double timeout)
+{
+  struct mount_namespace *namespaces = NULL;
+  struct mount_namespace_probe *mnps;
+  struct probe *probes;
+  struct dirent *de;
+  size_t i, count = 0, alloc = 0, mask = 1023, *slots;
+  DIR *dir;
+
+  dir = opendir ("/proc");
+  if (dir == NULL)
+    return NULL;
+
+  /* An open-addressing hash table of the indexes of the namespaces in
+     the array, with SIZE_MAX for the unused slots.  */
+  slots = xnmalloc (mask + 1, sizeof *slots);
+  memset (slots, 0xff, (mask + 1) * sizeof *slots);
+
+  while ((de = readdir (dir)) != NULL)
+    {
+      char path[64], *end;
+      struct stat st;
+      long pid;
+      size_t h;
+
+      pid = strtol (de->d_name, &end, 10);
+      if (end == de->d_name || *end != '\0' || pid <= 0)
+	continue;
+      snprintf (path, sizeof path, "/proc/%ld/ns/mnt", pid);
+      if (stat (path, &st) != 0)
+	continue;
+
+      for (h = hash_id (st.st_dev, st.st_ino, mask); slots[h] != SIZE_MAX;
+	   h = (h + 1) & mask)
+	if (namespaces[slots[h]].mn_dev == st.st_dev
+	    && namespaces[slots[h]].mn_id == st.st_ino)
+	  break;
+      if (slots[h] != SIZE_MAX)
+	{
+	  if (pid < namespaces[slots[h]].mn_pid)
+	    namespaces[slots[h]].mn_pid = pid;
+	  continue;
+	}
+
+      if (count == alloc)
+	namespaces = xrealloc (namespaces, (alloc = alloc ? 2 * alloc : 64)
+			       * sizeof *namespaces);
+      namespaces[count].mn_dev = st.st_dev;
+      namespaces[count].mn_id = st.st_ino;
+      namespaces[count].mn_pid = pid;
+      namespaces[count].mn_list = NULL;
+      namespaces[count].mn_timedout = false;
+      namespaces[count].mn_unreadable = false;
+      slots[h] = count++;
+
+      /* Keep the load factor of the hash table under one half.  */
+      if (2 * count > mask + 1)
+	{
+	  mask = 2 * mask + 1;
+	  slots = xrealloc (slots, (mask + 1) * sizeof *slots);
+	  memset (slots, 0xff, (mask + 1) * sizeof *slots);
+	  for (i = 0; i < count; i++)
+	    {
+	      for (h = hash_id (namespaces[i].mn_dev, namespaces[i].mn_id, mask);
+		   slots[h] != SIZE_MAX; h = (h + 1) & mask)
+		;
+	      slots[h] = i;
+	    }
+	}
+    }
+
+  closedir (dir);
+  free (slots);
+  if (namespaces)
+    qsort (namespaces, count, sizeof *namespaces, compare_pids);
+
+  mnps = xnmalloc (count ? count : 1, sizeof *mnps);
+  probes = xnmalloc (count ? count : 1, sizeof *probes);
+  for (i = 0; i < count; i++)
+    {
+      mnps[i].mnp_dev = namespaces[i].mn_dev;
+      mnps[i].mnp_ino = namespaces[i].mn_id;
+      mnps[i].mnp_pid = namespaces[i].mn_pid;
+      mnps[i].mnp_fields = fields;
+      mnps[i].mnp_list = NULL;
+      mnps[i].mnp_unreadable = false;
+      probes[i].pr_arg = &mnps[i];
+    }
+
+  if (run_probes (probes, count, read_namespace, workers, timeout) == 0)
+    {
+      for (i = 0; i < count; i++)
+	{
+	  namespaces[i].mn_pid = mnps[i].mnp_pid;
+	  namespaces[i].mn_list = mnps[i].mnp_list;
+	  namespaces[i].mn_unreadable = mnps[i].mnp_unreadable;
+	}
+      free (mnps);
+      free (probes);
+    }
+  else
+    /* The threads stuck in timed out probes may still write to them, so
+       they are not released.  */
+    for (i = 0; i < count; i++)
+      if (probes[i].pr_state == PROBE_TIMEDOUT)
+	namespaces[i].mn_timedout = true;
+      else
+	{
+	  namespaces[i].mn_pid = mnps[i].mnp_pid;
+	  namespaces[i].mn_list = mnps[i].mnp_list;
+	  namespaces[i].mn_unreadable = mnps[i].mnp_unreadable;
+	}
+
+  *n = count;
+  return namespaces ? namespaces : xmalloc (1);
+}
+
+#else /* !__linux__ */
+
+struct mount_namespace *
+read_mount_namespaces (size_t *n, unsigned int fields, unsigned int workers,
+		       double timeout)
+{
+  (void) n;
+  (void) fields;
+  (void) workers;
+  (void) timeout;
+  errno = ENOSYS;
+  return NULL;
+}
+
+#endif /* __linux__ */
+
+/* Release the N NAMESPACES returned by read_mount_namespaces, and their
+   mount lists.  */
+void
+free_mount_namespaces (struct mount_namespace *namespaces, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    free_mount_list (namespaces[i].mn_list);
+  free (namespaces);
+}
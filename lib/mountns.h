@@ -0,0 +1,27 @@
+#ifndef _MOUNTNS_H
+#define _MOUNTNS_H        1
+
+# include <stdbool.h>
+# include <stddef.h>
+# include <sys/types.h>
+
+# include "mountlist.h"
+
+/* A mount namespace, and the mount list seen by its processes.  */
+struct mount_namespace
+{
+  dev_t mn_dev;			/* Device number of the namespace. */
+  ino_t mn_id;			/* Inode number of the namespace. */
+  pid_t mn_pid;			/* PID its mount list was read from. */
+  struct mount_entry *mn_list;	/* Its mount list, or NULL. */
+  bool mn_timedout;		/* True if it could not be read in time. */
+  bool mn_unreadable;		/* True if it could not be read at all. */
+};
+
+struct mount_namespace *read_mount_namespaces (size_t *n,
+					       unsigned int fields,
+					       unsigned int workers,
+					       double timeout);
+void free_mount_namespaces (struct mount_namespace *namespaces, size_t n);
+
+#endif /* mountns.h */
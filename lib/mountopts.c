@@ -0,0 +1,117 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A parser for the comma-separated mount options
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "mountopts.h"
+
+#define OPTEQ(name, len, opt) \
+  (memcmp (name, opt, len) == 0)
+
+/* Return the MOUNT_OPT_* bit of the option NAME of LEN bytes, which is not
+   NUL-terminated, or 0 if the option is not a well-known one.  The options
+   are first told apart by their length, so that at most three comparisons
+   are made.  */
+unsigned int
+mount_option_flag (char const *name, size_t len)
+{
+  switch (len)
+    {
+    case 2:
+      if (name[0] == 'r' && name[1] == 'o')
+	return MOUNT_OPT_RO;
+      if (name[0] == 'r' && name[1] == 'w')
+	return MOUNT_OPT_RW;
+      break;
+    case 4:
+      if (OPTEQ (name, len, "sync"))
+	return MOUNT_OPT_SYNC;
+      if (OPTEQ (name, len, "mand"))
+	return MOUNT_OPT_MAND;
+      if (OPTEQ (name, len, "bind"))
+	return MOUNT_OPT_BIND;
+      break;
+    case 5:
+      if (OPTEQ (name, len, "nodev"))
+	return MOUNT_OPT_NODEV;
+      if (OPTEQ (name, len, "rbind"))
+	return MOUNT_OPT_BIND;
+      break;
+    case 6:
+      if (OPTEQ (name, len, "nosuid"))
+	return MOUNT_OPT_NOSUID;
+      if (OPTEQ (name, len, "noexec"))
+	return MOUNT_OPT_NOEXEC;
+      if (OPTEQ (name, len, "noauto"))
+	return MOUNT_OPT_NOAUTO;
+      if (OPTEQ (name, len, "ignore"))
+	return MOUNT_OPT_IGNORE;
+      break;
+    case 7:
+      if (OPTEQ (name, len, "noatime"))
+	return MOUNT_OPT_NOATIME;
+      if (OPTEQ (name, len, "dirsync"))
+	return MOUNT_OPT_DIRSYNC;
+      if (OPTEQ (name, len, "_netdev"))
+	return MOUNT_OPT_NETDEV;
+      break;
+    case 8:
+      if (OPTEQ (name, len, "relatime"))
+	return MOUNT_OPT_RELATIME;
+      if (OPTEQ (name, len, "lazytime"))
+	return MOUNT_OPT_LAZYTIME;
+      break;
+    case 10:
+      if (OPTEQ (name, len, "nodiratime"))
+	return MOUNT_OPT_NODIRATIME;
+      break;
+    case 11:
+      if (OPTEQ (name, len, "strictatime"))
+	return MOUNT_OPT_STRICTATIME;
+      break;
+    }
+
+  return 0;
+}
+
+/* Return the MOUNT_OPT_* bits of the well-known options found in the
+   comma-separated MOUNT_OPTIONS, in a single pass.  Unlike strtok, the
+   string is left untouched, so that it can still be displayed.  */
+unsigned int
+mount_options_flags (char const *mount_options)
+{
+  char const *p = mount_options;
+  char const *end = p + strlen (p);
+  unsigned int flags = 0;
+
+  while (p < end)
+    {
+      char const *comma = memchr (p, ',', end - p);
+      size_t len = (comma ? comma : end) - p;
+
+      flags |= mount_option_flag (p, len);
+      p += len + 1;
+    }
+
+  return flags;
+}
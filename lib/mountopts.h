@@ -0,0 +1,30 @@
+#ifndef _MOUNTOPTS_H
+#define _MOUNTOPTS_H        1
+
+/* Well-known mount options, as bits of the me_flags field of a mount
+   entry.  Options not listed here are ignored.  */
+enum mount_option
+{
+  MOUNT_OPT_RO = 1 << 0,	/* "ro" */
+  MOUNT_OPT_RW = 1 << 1,	/* "rw" */
+  MOUNT_OPT_NOSUID = 1 << 2,	/* "nosuid" */
+  MOUNT_OPT_NODEV = 1 << 3,	/* "nodev" */
+  MOUNT_OPT_NOEXEC = 1 << 4,	/* "noexec" */
+  MOUNT_OPT_SYNC = 1 << 5,	/* "sync" */
+  MOUNT_OPT_DIRSYNC = 1 << 6,	/* "dirsync" */
+  MOUNT_OPT_MAND = 1 << 7,	/* "mand" */
+  MOUNT_OPT_NOATIME = 1 << 8,	/* "noatime" */
+  MOUNT_OPT_NODIRATIME = 1 << 9,	/* "nodiratime" */
+  MOUNT_OPT_RELATIME = 1 << 10,	/* "relatime" */
+  MOUNT_OPT_STRICTATIME = 1 << 11,	/* "strictatime" */
+  MOUNT_OPT_LAZYTIME = 1 << 12,	/* "lazytime" */
+  MOUNT_OPT_BIND = 1 << 13,	/* "bind" or "rbind" */
+  MOUNT_OPT_NOAUTO = 1 << 14,	/* "noauto" */
+  MOUNT_OPT_NETDEV = 1 << 15,	/* "_netdev" */
+  MOUNT_OPT_IGNORE = 1 << 16	/* "ignore" */
+};
+
+unsigned int mount_option_flag (char const *name, size_t len);
+unsigned int mount_options_flags (char const *mount_options);
+
+#endif /* mountopts.h */
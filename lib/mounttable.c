@@ -0,0 +1,344 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A compact, array based layout of a mount list
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Walking a mount list costs a cache miss or more for each entry, since
+   the entries and their strings are scattered in memory.  A mount table
+   holds the same data in parallel arrays, and the attributes used to
+   select the entries to be checked in bitsets: the selection of the
+   entries is then made of a few operations for each word of 64 entries,
+   and of a lookup in the type sets for each distinct type rather than for
+   each entry.  The entries of the list are still reachable from the
+   table, for the code working on them.  */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "fstype.h"
+#include "mounttable.h"
+#include "xalloc.h"
+
+/* The type IDs are 16-bit numbers.  */
+#define MOUNT_TABLE_MAX_TYPES 65536
+
+/* An open-addressing hash table of the distinct types of a table, whose
+   slots hold the type IDs plus one, or 0 when unused.  */
+struct type_hash
+{
+  uint32_t *th_slots;
+  size_t th_mask;
+};
+
+/* Return the slot of HASH holding TYPE, whose hash value is H, or the
+   unused slot where it should be inserted.  */
+static uint32_t *
+find_type (struct mount_table const *table, struct type_hash const *hash,
+	   char const *type, size_t h)
+{
+  size_t i;
+
+  for (i = h & hash->th_mask; hash->th_slots[i] != 0;
+       i = (i + 1) & hash->th_mask)
+    if (strcmp (table->mt_types[hash->th_slots[i] - 1], type) == 0)
+      break;
+
+  return &hash->th_slots[i];
+}
+
+/* Return the ID of TYPE in TABLE.  A new type is copied at offset *USED
+   of the strings of TABLE, and *USED is updated.  Return -1 if there are
+   too many distinct types.  */
+static long
+type_id (struct mount_table *table, struct type_hash *hash, char const *type,
+	 size_t *used)
+{
+  size_t i, len;
+  uint32_t *slot = find_type (table, hash, type, fstype_hash (type, &len, 0));
+
+  if (*slot != 0)
+    return *slot - 1;
+  if (table->mt_n_types == MOUNT_TABLE_MAX_TYPES)
+    return -1;
+
+  memcpy (table->mt_strings + *used, type, len + 1);
+  table->mt_types[table->mt_n_types] = table->mt_strings + *used;
+  *used += len + 1;
+  *slot = ++table->mt_n_types;
+
+  /* Keep the load factor under one half.  */
+  if (2 * table->mt_n_types > hash->th_mask)
+    {
+      hash->th_mask = 2 * hash->th_mask + 1;
+      hash->th_slots = xrealloc (hash->th_slots, (hash->th_mask + 1)
+				 * sizeof *hash->th_slots);
+      memset (hash->th_slots, 0,
+	      (hash->th_mask + 1) * sizeof *hash->th_slots);
+      for (i = 0; i < table->mt_n_types; i++)
+	*find_type (table, hash, table->mt_types[i],
+		    fstype_hash (table->mt_types[i], &len, 0)) = i + 1;
+    }
+
+  return table->mt_n_types - 1;
+}
+
+/* Copy STR at offset *USED of the strings of TABLE, update *USED, and
+   return the offset of the copy.  */
+static uint32_t
+copy_string (struct mount_table *table, char const *str, size_t *used)
+{
+  size_t offset = *used, len = strlen (str) + 1;
+
+  memcpy (table->mt_strings + offset, str, len);
+  *used += len;
+
+  return offset;
+}
+
+/* Set in BITS the bit of the entry I if VALUE is true.  */
+static void
+set_bit (uint64_t *bits, size_t i, bool value)
+{
+  bits[i / MOUNT_TABLE_WORD_BITS] |=
+    (uint64_t) value << (i % MOUNT_TABLE_WORD_BITS);
+}
+
+/* Build a table holding a copy of MOUNT_LIST.  The list must not be
+   released while the table is in use.  Return NULL if the strings of the
+   list do not fit in 4 GiB, or if it has more than 65536 distinct
+   types.  */
+struct mount_table *
+mount_table_new (struct mount_entry *mount_list)
+{
+  struct mount_table *table;
+  struct mount_entry *me;
+  struct type_hash hash;
+  size_t i, n = 0, size = 0, used = 0;
+
+  for (me = mount_list; me; me = me->me_next)
+    {
+      n++;
+      size += strlen (me->me_devname) + strlen (me->me_mountdir)
+	+ strlen (me->me_type) + strlen (me->me_opts) + 4;
+    }
+  if (size > UINT32_MAX)
+    return NULL;
+
+  table = xmalloc (sizeof *table);
+  table->mt_count = n;
+  table->mt_words = (n + MOUNT_TABLE_WORD_BITS - 1) / MOUNT_TABLE_WORD_BITS;
+  table->mt_strings = xmalloc (size ? size : 1);
+  table->mt_devname = xnmalloc (n ? n : 1, sizeof *table->mt_devname);
+  table->mt_mountdir = xnmalloc (n ? n : 1, sizeof *table->mt_mountdir);
+  table->mt_opts = xnmalloc (n ? n : 1, sizeof *table->mt_opts);
+  table->mt_type = xnmalloc (n ? n : 1, sizeof *table->mt_type);
+  table->mt_flags = xnmalloc (n ? n : 1, sizeof *table->mt_flags);
+  table->mt_dev = xnmalloc (n ? n : 1, sizeof *table->mt_dev);
+  table->mt_types = xnmalloc (n < MOUNT_TABLE_MAX_TYPES
+			      ? (n ? n : 1) : MOUNT_TABLE_MAX_TYPES,
+			      sizeof *table->mt_types);
+  table->mt_n_types = 0;
+  table->mt_entries = xnmalloc (n ? n : 1, sizeof *table->mt_entries);
+
+  /* All the bitsets are allocated in a single block.  */
+  table->mt_dummy = xnmalloc (4 * (table->mt_words ? table->mt_words : 1),
+			      sizeof (uint64_t));
+  memset (table->mt_dummy, 0, 4 * table->mt_words * sizeof (uint64_t));
+  table->mt_remote = table->mt_dummy + table->mt_words;
+  table->mt_readonly = table->mt_remote + table->mt_words;
+  table->mt_unknown = table->mt_readonly + table->mt_words;
+
+  hash.th_mask = 63;
+  hash.th_slots = xnmalloc (hash.th_mask + 1, sizeof *hash.th_slots);
+  memset (hash.th_slots, 0, (hash.th_mask + 1) * sizeof *hash.th_slots);
+
+  for (me = mount_list, i = 0; me; me = me->me_next, i++)
+    {
+      long id;
+
+      table->mt_devname[i] = copy_string (table, me->me_devname, &used);
+      table->mt_mountdir[i] = copy_string (table, me->me_mountdir, &used);
+      table->mt_opts[i] = copy_string (table, me->me_opts, &used);
+
+      /* The type is only stored once.  */
+      id = type_id (table, &hash, me->me_type, &used);
+      if (id < 0)
+	{
+	  free (hash.th_slots);
+	  mount_table_free (table);
+	  return NULL;
+	}
+      table->mt_type[i] = id;
+
+      table->mt_flags[i] = me->me_flags;
+      table->mt_dev[i] = me->me_dev;
+      table->mt_entries[i] = me;
+      set_bit (table->mt_dummy, i, me->me_dummy);
+      set_bit (table->mt_remote, i, me->me_remote);
+      set_bit (table->mt_readonly, i, me->me_readonly);
+      set_bit (table->mt_unknown, i, me->me_unknown);
+    }
+
+  free (hash.th_slots);
+  return table;
+}
+
+/* Copy again to TABLE the readonly and unknown states of the entries of
+   its list, which might have been changed after the table was built.  */
+void
+mount_table_update (struct mount_table *table)
+{
+  size_t i;
+
+  memset (table->mt_readonly, 0, 2 * table->mt_words * sizeof (uint64_t));
+  for (i = 0; i < table->mt_count; i++)
+    {
+      set_bit (table->mt_readonly, i, table->mt_entries[i]->me_readonly);
+      set_bit (table->mt_unknown, i, table->mt_entries[i]->me_unknown);
+    }
+}
+
+/* Store in the bitset BITS, of TABLE->mt_words words, the entries of
+   TABLE to be checked: if LOCAL_ONLY is true the remote ones are left
+   out, and if SHOW_DUMMY is false the dummy ones.  The entries must also
+   have a type in the set SELECTED, if not NULL, and not in the set
+   EXCLUDED, if not NULL.  */
+void
+mount_table_select (struct mount_table const *table, bool local_only,
+		    bool show_dummy, struct fstype_set *selected,
+		    struct fstype_set *excluded, uint64_t *bits)
+{
+  uint64_t local_mask = local_only ? ~(uint64_t) 0 : 0;
+  uint64_t dummy_mask = show_dummy ? 0 : ~(uint64_t) 0;
+  bool *type_ok = NULL;
+  size_t i, w;
+
+  /* The type sets are looked up once for each distinct type.  */
+  if (selected || excluded)
+    {
+      type_ok = xnmalloc (table->mt_n_types ? table->mt_n_types : 1,
+			  sizeof *type_ok);
+      for (i = 0; i < table->mt_n_types; i++)
+	type_ok[i] =
+	  (selected == NULL || fstype_set_match (selected, table->mt_types[i]))
+	  && !(excluded && fstype_set_match (excluded, table->mt_types[i]));
+    }
+
+  for (w = 0; w < table->mt_words; w++)
+    bits[w] = ~((table->mt_remote[w] & local_mask)
+		| (table->mt_dummy[w] & dummy_mask));
+
+  /* Clear the bits past the last entry.  */
+  if (table->mt_count % MOUNT_TABLE_WORD_BITS)
+    bits[table->mt_words - 1] &=
+      ((uint64_t) 1 << (table->mt_count % MOUNT_TABLE_WORD_BITS)) - 1;
+
+  if (type_ok)
+    {
+      for (w = 0; w < table->mt_words; w++)
+	{
+	  size_t first = w * MOUNT_TABLE_WORD_BITS;
+	  size_t last = first + MOUNT_TABLE_WORD_BITS;
+	  uint64_t types = 0;
+
+	  if (last > table->mt_count)
+	    last = table->mt_count;
+	  for (i = first; i < last; i++)
+	    types |= (uint64_t) type_ok[table->mt_type[i]] << (i - first);
+	  bits[w] &= types;
+	}
+      free (type_ok);
+    }
+}
+
+/* Clear in the bitset BITS, of TABLE->mt_words words, the entries of
+   TABLE whose mount point is not in the set INCLUDED, if not NULL, or is
+   in the set EXCLUDED, if not NULL.  Only the entries whose bit is set
+   are looked up.  */
+void
+mount_table_select_paths (struct mount_table const *table,
+			  struct path_set *included, struct path_set *excluded,
+			  uint64_t *bits)
+{
+  size_t i;
+
+  if (included == NULL && excluded == NULL)
+    return;
+
+  for (i = mount_table_next (table, bits, 0); i < table->mt_count;
+       i = mount_table_next (table, bits, i + 1))
+    {
+      char const *dir = table->mt_strings + table->mt_mountdir[i];
+
+      if ((included && !path_set_match (included, dir))
+	  || (excluded && path_set_match (excluded, dir)))
+	bits[i / MOUNT_TABLE_WORD_BITS] &=
+	  ~((uint64_t) 1 << (i % MOUNT_TABLE_WORD_BITS));
+    }
+}
+
+/* Return the index of the first entry of TABLE from I on whose bit is set
+   in BITS, or TABLE->mt_count if there is none.  */
+size_t
+mount_table_next (struct mount_table const *table, uint64_t const *bits,
+		  size_t i)
+{
+  size_t w = i / MOUNT_TABLE_WORD_BITS;
+  uint64_t word;
+
+  if (i >= table->mt_count)
+    return table->mt_count;
+
+  word = bits[w] & (~(uint64_t) 0 << (i % MOUNT_TABLE_WORD_BITS));
+  while (word == 0)
+    {
+      if (++w == table->mt_words)
+	return table->mt_count;
+      word = bits[w];
+    }
+
+#if defined __GNUC__ && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+  return w * MOUNT_TABLE_WORD_BITS + __builtin_ctzll (word);
+#else
+  for (i = 0; !(word & 1); i++)
+    word >>= 1;
+  return w * MOUNT_TABLE_WORD_BITS + i;
+#endif
+}
+
+/* Release the table TABLE, but not its list.  */
+void
+mount_table_free (struct mount_table *table)
+{
+  if (table)
+    {
+      free (table->mt_strings);
+      free (table->mt_devname);
+      free (table->mt_mountdir);
+      free (table->mt_opts);
+      free (table->mt_type);
+      free (table->mt_flags);
+      free (table->mt_dev);
+      free (table->mt_types);
+      free (table->mt_dummy);
+      free (table->mt_entries);
+      free (table);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef _MOUNTTABLE_H
+#define _MOUNTTABLE_H        1
+
+# include <stddef.h>
+# include <stdint.h>
+# include <sys/types.h>
+
+# include "fstypeset.h"
+# include "mountlist.h"
+# include "pathset.h"
+
+/* Number of entries in a word of the bitsets of a mount table.  */
+# define MOUNT_TABLE_WORD_BITS 64
+
+/* A compact copy of a mount list, laid out as parallel arrays indexed by
+   the position of the entries in the list.  The strings are stored in a
+   single block, and the boolean attributes in bitsets, so that the
+   entries can be filtered a word of 64 entries at a time.  */
+struct mount_table
+{
+  size_t mt_count;		/* Number of entries. */
+  size_t mt_words;		/* Number of words of each bitset. */
+  char *mt_strings;		/* The strings of all the entries. */
+  uint32_t *mt_devname;		/* Offsets of the strings in mt_strings. */
+  uint32_t *mt_mountdir;
+  uint32_t *mt_opts;
+  uint16_t *mt_type;		/* Types, as indexes in mt_types. */
+  unsigned int *mt_flags;	/* MOUNT_OPT_* flags. */
+  dev_t *mt_dev;		/* Device numbers. */
+  char const **mt_types;	/* The distinct types, in mt_strings. */
+  size_t mt_n_types;
+  uint64_t *mt_dummy;		/* Bitsets of the entries flags. */
+  uint64_t *mt_remote;
+  uint64_t *mt_readonly;
+  uint64_t *mt_unknown;
+  struct mount_entry **mt_entries; /* The entries of the list. */
+};
+
+struct mount_table *mount_table_new (struct mount_entry *mount_list);
+void mount_table_update (struct mount_table *table);
+void mount_table_select (struct mount_table const *table, bool local_only,
+			 bool show_dummy, struct fstype_set *selected,
+			 struct fstype_set *excluded, uint64_t *bits);
+void mount_table_select_paths (struct mount_table const *table,
+			       struct path_set *included,
+			       struct path_set *excluded, uint64_t *bits);
+size_t mount_table_next (struct mount_table const *table,
+			 uint64_t const *bits, size_t i);
+void mount_table_free (struct mount_table *table);
+
+#endif /* mounttable.h */
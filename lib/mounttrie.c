@@ -0,0 +1,255 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A trie over the path components of the mount points of a mount list
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Each node of the trie is a directory leading to a mount point, and each
+   edge a path component.  The nodes are stored in a single array, and the
+   edges in an open-addressing hash table keyed by the parent node and the
+   component, so that a path is resolved with one hash lookup per
+   component, whatever the number of mounts.
+
+   A node remembers the last entry mounted on its directory, and the
+   position of the entry in the mount list.  An entry mounted on a
+   directory hides the entries mounted below it before, so the mount
+   holding a path is the deepest one along the path that was mounted after
+   all the ones above it.  */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mounttrie.h"
+#include "xalloc.h"
+
+struct mount_trie_node
+{
+  size_t mtn_parent;		/* Index of the parent node. */
+  char const *mtn_name;		/* Path component, not NUL-terminated. */
+  size_t mtn_len;		/* Length of the path component. */
+  size_t mtn_hash;		/* Hash value of the parent and component. */
+  struct mount_entry *mtn_entry; /* Last entry mounted here, or NULL. */
+  size_t mtn_seq;		/* Position of mtn_entry in the list. */
+};
+
+struct mount_trie
+{
+  struct mount_trie_node *mt_nodes; /* The root directory is node 0. */
+  size_t mt_n_nodes;
+  size_t mt_n_alloc;
+  size_t *mt_slots;		/* Child nodes, or 0 for the unused slots. */
+  size_t mt_mask;		/* Number of slots minus one. */
+};
+
+/* Return the hash value of the component NAME, of length LEN, of the
+   directory whose node is PARENT.  */
+static size_t
+hash_component (size_t parent, char const *name, size_t len)
+{
+  uint64_t h = 14695981039346656037ULL ^ (parent * 0x9e3779b97f4a7c15ULL);
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    h = (h ^ (unsigned char) name[i]) * 1099511628211ULL;
+
+  return (size_t) (h ^ (h >> 32));
+}
+
+/* Return the first component of PATH, skipping the slashes and the "."
+   components, and store its length in *LEN.  Return NULL at the end of
+   PATH.  */
+static char const *
+next_component (char const *path, size_t *len)
+{
+  for (;;)
+    {
+      while (*path == '/')
+	path++;
+      if (*path == '\0')
+	return NULL;
+      *len = strcspn (path, "/");
+      if (!(*len == 1 && *path == '.'))
+	return path;
+      path++;
+    }
+}
+
+/* Return the slot of TRIE holding the child NAME, of length LEN, of the
+   node PARENT, or the unused slot where it should be inserted.  HASH is
+   the value of hash_component for the child.  */
+static size_t *
+find_slot (struct mount_trie const *trie, size_t parent, char const *name,
+	   size_t len, size_t hash)
+{
+  size_t i = hash & trie->mt_mask;
+
+  for (;; i = (i + 1) & trie->mt_mask)
+    {
+      size_t *slot = &trie->mt_slots[i];
+      struct mount_trie_node const *node = &trie->mt_nodes[*slot];
+
+      if (*slot == 0
+	  || (node->mtn_hash == hash && node->mtn_parent == parent
+	      && node->mtn_len == len
+	      && memcmp (node->mtn_name, name, len) == 0))
+	return slot;
+    }
+}
+
+/* Add to TRIE the child NAME of the node PARENT, and return its node.  */
+static size_t
+add_node (struct mount_trie *trie, size_t parent, char const *name,
+	  size_t len, size_t hash)
+{
+  struct mount_trie_node *node;
+
+  /* Keep the load factor of the hash table under one half.  */
+  if (2 * trie->mt_n_nodes >= trie->mt_mask + 1)
+    {
+      size_t i;
+
+      trie->mt_mask = 2 * trie->mt_mask + 1;
+      trie->mt_slots = xrealloc (trie->mt_slots, (trie->mt_mask + 1)
+				 * sizeof *trie->mt_slots);
+      memset (trie->mt_slots, 0, (trie->mt_mask + 1) * sizeof *trie->mt_slots);
+      for (i = 1; i < trie->mt_n_nodes; i++)
+	{
+	  node = &trie->mt_nodes[i];
+	  *find_slot (trie, node->mtn_parent, node->mtn_name, node->mtn_len,
+		      node->mtn_hash) = i;
+	}
+    }
+
+  if (trie->mt_n_nodes == trie->mt_n_alloc)
+    {
+      trie->mt_n_alloc *= 2;
+      trie->mt_nodes = xrealloc (trie->mt_nodes, trie->mt_n_alloc
+				 * sizeof *trie->mt_nodes);
+    }
+
+  node = &trie->mt_nodes[trie->mt_n_nodes];
+  node->mtn_parent = parent;
+  node->mtn_name = name;
+  node->mtn_len = len;
+  node->mtn_hash = hash;
+  node->mtn_entry = NULL;
+  node->mtn_seq = 0;
+  *find_slot (trie, parent, name, len, hash) = trie->mt_n_nodes;
+
+  return trie->mt_n_nodes++;
+}
+
+/* Build a trie over the mount points of MOUNT_LIST.  The entries whose
+   mount point is not an absolute file name are left out.  The list must
+   not be modified or released while the trie is in use.  */
+struct mount_trie *
+mount_trie_new (struct mount_entry *mount_list)
+{
+  struct mount_trie *trie = xmalloc (sizeof *trie);
+  struct mount_entry *me;
+  size_t seq = 0;
+
+  trie->mt_n_alloc = 64;
+  trie->mt_nodes = xnmalloc (trie->mt_n_alloc, sizeof *trie->mt_nodes);
+  trie->mt_mask = 2 * trie->mt_n_alloc - 1;
+  trie->mt_slots = xnmalloc (trie->mt_mask + 1, sizeof *trie->mt_slots);
+  memset (trie->mt_slots, 0, (trie->mt_mask + 1) * sizeof *trie->mt_slots);
+
+  trie->mt_n_nodes = 1;
+  trie->mt_nodes[0].mtn_parent = 0;
+  trie->mt_nodes[0].mtn_name = "";
+  trie->mt_nodes[0].mtn_len = 0;
+  trie->mt_nodes[0].mtn_hash = 0;
+  trie->mt_nodes[0].mtn_entry = NULL;
+  trie->mt_nodes[0].mtn_seq = 0;
+
+  for (me = mount_list; me; me = me->me_next)
+    {
+      char const *name, *path = me->me_mountdir;
+      size_t len, node = 0;
+
+      seq++;
+      if (*path != '/')
+	continue;
+
+      while ((name = next_component (path, &len)))
+	{
+	  size_t hash = hash_component (node, name, len);
+	  size_t child = *find_slot (trie, node, name, len, hash);
+
+	  node = child ? child : add_node (trie, node, name, len, hash);
+	  path = name + len;
+	}
+
+      /* An over-mount hides the entries mounted before on the same
+	 directory.  */
+      trie->mt_nodes[node].mtn_entry = me;
+      trie->mt_nodes[node].mtn_seq = seq;
+    }
+
+  return trie;
+}
+
+/* Return the entry of the indexed mount list holding PATH, that is the
+   innermost visible mount along PATH, or NULL if there is none.  PATH must
+   be an absolute file name without symbolic links or ".." components,
+   like the ones returned by realpath.  */
+struct mount_entry *
+mount_trie_lookup (struct mount_trie const *trie, char const *path)
+{
+  struct mount_trie_node const *node = &trie->mt_nodes[0];
+  struct mount_entry *me = node->mtn_entry;
+  size_t seq = node->mtn_seq, parent = 0, len;
+  char const *name;
+
+  if (*path != '/')
+    return NULL;
+
+  while ((name = next_component (path, &len)))
+    {
+      parent = *find_slot (trie, parent, name, len,
+			   hash_component (parent, name, len));
+      if (parent == 0)
+	break;
+
+      /* A mount older than the ones above it is hidden by them.  */
+      node = &trie->mt_nodes[parent];
+      if (node->mtn_entry && node->mtn_seq > seq)
+	{
+	  me = node->mtn_entry;
+	  seq = node->mtn_seq;
+	}
+      path = name + len;
+    }
+
+  return me;
+}
+
+/* Release the trie TRIE.  */
+void
+mount_trie_free (struct mount_trie *trie)
+{
+  if (trie)
+    {
+      free (trie->mt_nodes);
+      free (trie->mt_slots);
+      free (trie);
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef _MOUNTTRIE_H
+#define _MOUNTTRIE_H        1
+
+# include "mountlist.h"
+
+/* A trie over the path components of the mount points of a mount list,
+   resolving any path to the mount holding it.  */
+struct mount_trie;
+
+struct mount_trie *mount_trie_new (struct mount_entry *mount_list);
+struct mount_entry *mount_trie_lookup (struct mount_trie const *trie,
+				       char const *path);
+void mount_trie_free (struct mount_trie *trie);
+
+#endif /* mounttrie.h */
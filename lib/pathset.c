@@ -0,0 +1,339 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Sets of file names given by name or by glob pattern
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The patterns of a set are compiled into a single trie of their path
+   components, so that a file name is matched against all of them in one
+   pass over its components, however many patterns there are.  As in the
+   trie over the mount points, the nodes are stored in a single array, and
+   the edges in an open-addressing hash table keyed by the parent node and
+   the component.  A component holding a wildcard is a glob edge, also
+   linked to the list of the glob edges of its parent, and matched with
+   fnmatch against a single component of the file names, so that a
+   wildcard never matches a '/'.
+
+   A file name walks the trie a component at a time, with the set of the
+   nodes reached so far: one literal lookup and a match of the glob edges
+   for each of them.  The walk stops at the first node ending a pattern,
+   since the pattern then matches the file name or a directory holding
+   it, or when no node is left.  */
+
+#include "config.h"
+
+#include <fnmatch.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pathset.h"
+#include "xalloc.h"
+
+struct path_set_node
+{
+  size_t psn_parent;		/* Index of the parent node. */
+  char *psn_name;		/* Path component, or glob pattern. */
+  size_t psn_len;		/* Length of the path component. */
+  size_t psn_hash;		/* Hash value of the parent and component. */
+  bool psn_glob;		/* True if psn_name is a glob pattern. */
+  bool psn_prefix_only;		/* True if the pattern is PREFIX*. */
+  size_t psn_prefix_len;	/* Length of the prefix before the '*'. */
+  bool psn_final;		/* True if a pattern ends here. */
+  size_t psn_literals;		/* Number of literal children. */
+  size_t psn_globs;		/* First glob child, or 0 if none. */
+  size_t psn_next_glob;		/* Next glob sibling, or 0 if none. */
+};
+
+struct path_set
+{
+  struct path_set_node *ps_nodes; /* The root directory is node 0. */
+  size_t ps_n_nodes;
+  size_t ps_n_alloc;
+  size_t *ps_slots;		/* Child nodes, or 0 for the unused slots. */
+  size_t ps_mask;		/* Number of slots minus one. */
+  size_t *ps_active;		/* The nodes reached by path_set_match. */
+  char *ps_component;		/* A NUL-terminated copy of a component. */
+  size_t ps_component_alloc;
+};
+
+/* Return the hash value of the component NAME, of length LEN, of the
+   directory whose node is PARENT.  */
+static size_t
+hash_component (size_t parent, char const *name, size_t len)
+{
+  uint64_t h = 14695981039346656037ULL ^ (parent * 0x9e3779b97f4a7c15ULL);
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    h = (h ^ (unsigned char) name[i]) * 1099511628211ULL;
+
+  return (size_t) (h ^ (h >> 32));
+}
+
+/* Return the first component of PATH, skipping the slashes and the "."
+   components, and store its length in *LEN.  Return NULL at the end of
+   PATH.  */
+static char const *
+next_component (char const *path, size_t *len)
+{
+  for (;;)
+    {
+      while (*path == '/')
+	path++;
+      if (*path == '\0')
+	return NULL;
+      *len = strcspn (path, "/");
+      if (!(*len == 1 && *path == '.'))
+	return path;
+      path++;
+    }
+}
+
+/* Return the slot of SET holding the child NAME, of length LEN, of the
+   node PARENT, either a glob edge if GLOB is true or a literal one, or
+   the unused slot where it should be inserted.  HASH is the value of
+   hash_component for the child.  */
+static size_t *
+find_slot (struct path_set const *set, size_t parent, char const *name,
+	   size_t len, size_t hash, bool glob)
+{
+  size_t i = hash & set->ps_mask;
+
+  for (;; i = (i + 1) & set->ps_mask)
+    {
+      size_t *slot = &set->ps_slots[i];
+      struct path_set_node const *node = &set->ps_nodes[*slot];
+
+      if (*slot == 0
+	  || (node->psn_hash == hash && node->psn_parent == parent
+	      && node->psn_len == len && node->psn_glob == glob
+	      && memcmp (node->psn_name, name, len) == 0))
+	return slot;
+    }
+}
+
+/* Add to SET the child NAME of the node PARENT, and return its node.  */
+static size_t
+add_node (struct path_set *set, size_t parent, char const *name,
+	  size_t len, size_t hash, bool glob)
+{
+  struct path_set_node *node;
+  size_t i;
+
+  /* Keep the load factor of the hash table under one half.  */
+  if (2 * set->ps_n_nodes >= set->ps_mask + 1)
+    {
+      set->ps_mask = 2 * set->ps_mask + 1;
+      set->ps_slots = xrealloc (set->ps_slots, (set->ps_mask + 1)
+				* sizeof *set->ps_slots);
+      memset (set->ps_slots, 0, (set->ps_mask + 1) * sizeof *set->ps_slots);
+      for (i = 1; i < set->ps_n_nodes; i++)
+	{
+	  node = &set->ps_nodes[i];
+	  *find_slot (set, node->psn_parent, node->psn_name, node->psn_len,
+		      node->psn_hash, node->psn_glob) = i;
+	}
+    }
+
+  /* Each node is reached at most once by a step of path_set_match, so
+     the nodes reached by two steps fit in twice the number of nodes.  */
+  if (set->ps_n_nodes == set->ps_n_alloc)
+    {
+      set->ps_n_alloc *= 2;
+      set->ps_nodes = xrealloc (set->ps_nodes, set->ps_n_alloc
+				* sizeof *set->ps_nodes);
+      set->ps_active = xrealloc (set->ps_active, 2 * set->ps_n_alloc
+				 * sizeof *set->ps_active);
+    }
+
+  node = &set->ps_nodes[set->ps_n_nodes];
+  node->psn_parent = parent;
+  node->psn_name = xmalloc (len + 1);
+  memcpy (node->psn_name, name, len);
+  node->psn_name[len] = '\0';
+  node->psn_len = len;
+  node->psn_hash = hash;
+  node->psn_glob = glob;
+  node->psn_prefix_only = false;
+  node->psn_prefix_len = 0;
+  node->psn_final = false;
+  node->psn_literals = 0;
+  node->psn_globs = 0;
+  node->psn_next_glob = 0;
+  *find_slot (set, parent, name, len, hash, glob) = set->ps_n_nodes;
+
+  if (glob)
+    {
+      char const *wildcard = strpbrk (node->psn_name, "*?[\\");
+
+      node->psn_prefix_len = wildcard - node->psn_name;
+      node->psn_prefix_only = (*wildcard == '*' && wildcard[1] == '\0');
+      node->psn_next_glob = set->ps_nodes[parent].psn_globs;
+      set->ps_nodes[parent].psn_globs = set->ps_n_nodes;
+    }
+  else
+    set->ps_nodes[parent].psn_literals++;
+
+  return set->ps_n_nodes++;
+}
+
+/* Return true if the glob edge NODE matches the component NAME, of
+   length LEN.  */
+static bool
+glob_match (struct path_set *set, struct path_set_node const *node,
+	    char const *name, size_t len)
+{
+  if (len < node->psn_prefix_len
+      || memcmp (name, node->psn_name, node->psn_prefix_len) != 0)
+    return false;
+  if (node->psn_prefix_only)
+    return true;
+
+  if (len >= set->ps_component_alloc)
+    {
+      set->ps_component_alloc = 2 * len + 1;
+      set->ps_component = xrealloc (set->ps_component,
+				    set->ps_component_alloc);
+    }
+  memcpy (set->ps_component, name, len);
+  set->ps_component[len] = '\0';
+
+  return fnmatch (node->psn_name, set->ps_component, 0) == 0;
+}
+
+/* Return a new empty set.  */
+struct path_set *
+path_set_new (void)
+{
+  struct path_set *set = xmalloc (sizeof *set);
+
+  set->ps_n_alloc = 64;
+  set->ps_nodes = xnmalloc (set->ps_n_alloc, sizeof *set->ps_nodes);
+  set->ps_active = xnmalloc (2 * set->ps_n_alloc, sizeof *set->ps_active);
+  set->ps_mask = 2 * set->ps_n_alloc - 1;
+  set->ps_slots = xnmalloc (set->ps_mask + 1, sizeof *set->ps_slots);
+  memset (set->ps_slots, 0, (set->ps_mask + 1) * sizeof *set->ps_slots);
+  set->ps_component = NULL;
+  set->ps_component_alloc = 0;
+
+  set->ps_n_nodes = 1;
+  memset (&set->ps_nodes[0], 0, sizeof set->ps_nodes[0]);
+  set->ps_nodes[0].psn_name = xmalloc (1);
+  set->ps_nodes[0].psn_name[0] = '\0';
+
+  return set;
+}
+
+/* Add to SET the absolute file name PATTERN, whose components are glob
+   patterns if they contain any of the wildcards '*', '?' or '['.  The
+   file names matched by the pattern, and the files below them, are then
+   in SET.  */
+void
+path_set_add (struct path_set *set, char const *pattern)
+{
+  char const *name;
+  size_t len, node = 0;
+
+  while ((name = next_component (pattern, &len)))
+    {
+      bool glob = false;
+      size_t i, hash, child;
+
+      for (i = 0; i < len && !glob; i++)
+	glob = strchr ("*?[\\", name[i]) != NULL;
+      hash = hash_component (node, name, len);
+      child = *find_slot (set, node, name, len, hash, glob);
+
+      node = child ? child : add_node (set, node, name, len, hash, glob);
+      pattern = name + len;
+    }
+
+  set->ps_nodes[node].psn_final = true;
+}
+
+/* Return true if PATH, or one of the directories holding it, is matched
+   by a pattern of SET.  */
+bool
+path_set_match (struct path_set *set, char const *path)
+{
+  size_t *active = set->ps_active, *next = active + set->ps_n_alloc;
+  size_t n_active = 1, n_next, i, len;
+  char const *name;
+
+  if (set->ps_nodes[0].psn_final)
+    return true;
+
+  active[0] = 0;
+  while ((name = next_component (path, &len)))
+    {
+      size_t *reached = next;
+
+      for (i = 0, n_next = 0; i < n_active; i++)
+	{
+	  size_t node = active[i], child = 0;
+
+	  /* The components matched by a '*' edge, like the IDs of the
+	     containers, are often long: they are only hashed if needed.  */
+	  if (set->ps_nodes[node].psn_literals > 0)
+	    child = *find_slot (set, node, name, len,
+				hash_component (node, name, len), false);
+	  if (child)
+	    {
+	      if (set->ps_nodes[child].psn_final)
+		return true;
+	      next[n_next++] = child;
+	    }
+
+	  for (child = set->ps_nodes[node].psn_globs; child;
+	       child = set->ps_nodes[child].psn_next_glob)
+	    if (glob_match (set, &set->ps_nodes[child], name, len))
+	      {
+		if (set->ps_nodes[child].psn_final)
+		  return true;
+		next[n_next++] = child;
+	      }
+	}
+
+      if (n_next == 0)
+	return false;
+      next = active;
+      active = reached;
+      n_active = n_next;
+      path = name + len;
+    }
+
+  return false;
+}
+
+/* Release SET.  */
+void
+path_set_free (struct path_set *set)
+{
+  size_t i;
+
+  if (set == NULL)
+    return;
+
+  for (i = 0; i < set->ps_n_nodes; i++)
+    free (set->ps_nodes[i].psn_name);
+  free (set->ps_nodes);
+  free (set->ps_slots);
+  free (set->ps_active);
+  free (set->ps_component);
+  free (set);
+}
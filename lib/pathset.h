@@ -0,0 +1,15 @@
+#ifndef _PATHSET_H
+#define _PATHSET_H        1
+
+# include <stdbool.h>
+
+/* A set of absolute file names, given by name or by glob pattern, each
+   matching itself and the files below it.  */
+struct path_set;
+
+struct path_set *path_set_new (void);
+void path_set_add (struct path_set *set, char const *pattern);
+bool path_set_match (struct path_set *set, char const *path);
+void path_set_free (struct path_set *set);
+
+#endif /* pathset.h */
@@ -0,0 +1,133 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Timing of the phases of a check, reported as performance data
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The time spent in each phase of a check is accumulated with the
+   monotonic clock, and printed in the performance data format of the
+   Nagios plugins ("label=value[UOM]"), along with a few counters and the
+   peak resident set size.  Only the phases and counters a check went
+   through are printed, so that the labels of a check are always the
+   same.  Nothing is measured until perf_enable is called.  */
+
+#include "config.h"
+
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "perfdata.h"
+
+static char const *const phase_labels[PERF_PHASES] = {
+  "trigger_time", "read_time", "lookup_time", "filter_time", "output_time"
+};
+
+static char const *const counter_labels[PERF_COUNTERS] = {
+  "entries_read", "entries_skipped"
+};
+
+static bool enabled;
+static double phase_times[PERF_PHASES];
+static bool phase_used[PERF_PHASES];
+static size_t counters[PERF_COUNTERS];
+static bool counter_used[PERF_COUNTERS];
+
+/* Start measuring if ENABLE is true, from scratch, and stop otherwise.  */
+void
+perf_enable (bool enable)
+{
+  enabled = enable;
+  memset (phase_times, 0, sizeof phase_times);
+  memset (phase_used, 0, sizeof phase_used);
+  memset (counters, 0, sizeof counters);
+  memset (counter_used, 0, sizeof counter_used);
+}
+
+/* Return true if the phases are being measured.  */
+bool
+perf_enabled (void)
+{
+  return enabled;
+}
+
+/* Return the start time of a phase, in seconds, to be passed to
+   perf_stop, or 0 if nothing is measured.  */
+double
+perf_start (void)
+{
+  struct timespec ts;
+
+  if (!enabled)
+    return 0;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Add to the time of PHASE the time elapsed since START, as returned by
+   perf_start.  */
+void
+perf_stop (enum perf_phase phase, double start)
+{
+  if (!enabled)
+    return;
+
+  phase_times[phase] += perf_start () - start;
+  phase_used[phase] = true;
+}
+
+/* Take out of the time of PHASE the time of the phase NESTED, measured
+   while PHASE was.  */
+void
+perf_discount (enum perf_phase phase, enum perf_phase nested)
+{
+  if (enabled && phase_used[nested])
+    phase_times[phase] -= phase_times[nested];
+}
+
+/* Add N to COUNTER.  */
+void
+perf_count (enum perf_counter counter, size_t n)
+{
+  if (!enabled)
+    return;
+
+  counters[counter] += n;
+  counter_used[counter] = true;
+}
+
+/* Print to OUT the performance data measured so far, each label preceded
+   by a space, followed by the peak resident set size.  */
+void
+perf_print (FILE *out)
+{
+  struct rusage usage;
+  int i;
+
+  if (!enabled)
+    return;
+
+  for (i = 0; i < PERF_PHASES; i++)
+    if (phase_used[i])
+      fprintf (out, " %s=%.3fms", phase_labels[i], phase_times[i] * 1e3);
+  for (i = 0; i < PERF_COUNTERS; i++)
+    if (counter_used[i])
+      fprintf (out, " %s=%lu", counter_labels[i], (unsigned long) counters[i]);
+  if (getrusage (RUSAGE_SELF, &usage) == 0)
+    fprintf (out, " max_rss=%ldKB", (long) usage.ru_maxrss);
+}
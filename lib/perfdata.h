@@ -0,0 +1,36 @@
+#ifndef _PERFDATA_H
+#define _PERFDATA_H        1
+
+# include <stdbool.h>
+# include <stddef.h>
+# include <stdio.h>
+
+/* The phases of a check timed for the performance data.  */
+enum perf_phase
+{
+  PERF_TRIGGER,			/* Automount triggering of the arguments. */
+  PERF_READ,			/* Reading, parsing and classification of
+				   the mount table. */
+  PERF_LOOKUP,			/* Indexing and lookup of the arguments. */
+  PERF_FILTER,			/* Selection of the entries to be checked. */
+  PERF_OUTPUT,			/* Printing of the results. */
+  PERF_PHASES
+};
+
+/* The counters of the performance data.  */
+enum perf_counter
+{
+  PERF_ENTRIES_READ,		/* Entries of the mount table. */
+  PERF_ENTRIES_SKIPPED,		/* Entries left out of the check. */
+  PERF_COUNTERS
+};
+
+void perf_enable (bool enable);
+bool perf_enabled (void);
+double perf_start (void);
+void perf_stop (enum perf_phase phase, double start);
+void perf_discount (enum perf_phase phase, enum perf_phase nested);
+void perf_count (enum perf_counter counter, size_t n);
+void perf_print (FILE *out);
+
+#endif /* perfdata.h */
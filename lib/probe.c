@@ -0,0 +1,212 @@
+/*
+ * License: GPL
+ * Copyright (c) 2013 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Run blocking probes on a bounded pool of threads with a deadline
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The system calls made on a dead NFS or CIFS server can block for a long
+   time, and a thread stuck in one of them cannot be cancelled.  So the
+   probes of a phase share one deadline: when it passes, all the probes not
+   done yet are given up and marked as timed out, their workers are left
+   behind, and the phase ends.  The phase thus never lasts much longer than
+   one timeout, however many probes are stuck, and the caller only wakes up
+   when a probe completes or at the deadline.  */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "probe.h"
+#include "xalloc.h"
+
+struct probe_pool
+{
+  pthread_mutex_t pp_lock;
+  pthread_cond_t pp_done;	/* Signaled when a probe completes. */
+  struct probe *pp_probes;
+  size_t pp_count;		/* Number of probes. */
+  size_t pp_next;		/* Next probe to be started. */
+  size_t pp_finished;		/* Probes either done or timed out. */
+  void (*pp_func) (void *);
+  unsigned int pp_refs;		/* The caller and the worker threads. */
+};
+
+/* Return the current time of CLOCK, in seconds.  */
+static double
+now (clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime (clock, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Drop a reference to POOL, whose lock is held, and release the pool if
+   it was the last one.  */
+static void
+pool_unref (struct probe_pool *pool)
+{
+  bool last = (--pool->pp_refs == 0);
+
+  pthread_mutex_unlock (&pool->pp_lock);
+  if (last)
+    {
+      pthread_mutex_destroy (&pool->pp_lock);
+      pthread_cond_destroy (&pool->pp_done);
+      free (pool);
+    }
+}
+
+/* Run the pending probes of the pool ARG, one at a time, until there are
+   none left or the current probe times out.  */
+static void *
+worker (void *arg)
+{
+  struct probe_pool *pool = arg;
+
+  pthread_mutex_lock (&pool->pp_lock);
+  while (pool->pp_next < pool->pp_count)
+    {
+      struct probe *probe = &pool->pp_probes[pool->pp_next++];
+      double start = now (CLOCK_MONOTONIC);
+
+      probe->pr_state = PROBE_RUNNING;
+      pthread_mutex_unlock (&pool->pp_lock);
+
+      pool->pp_func (probe->pr_arg);
+
+      pthread_mutex_lock (&pool->pp_lock);
+      /* The phase was given up in the meantime.  */
+      if (probe->pr_state == PROBE_TIMEDOUT)
+	break;
+      probe->pr_state = PROBE_DONE;
+      probe->pr_elapsed = now (CLOCK_MONOTONIC) - start;
+      pool->pp_finished++;
+      pthread_cond_signal (&pool->pp_done);
+    }
+
+  pool_unref (pool);
+  return NULL;
+}
+
+/* Start a new worker thread for POOL, whose lock is held.  Return false on
+   error.  */
+static bool
+start_worker (struct probe_pool *pool)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  bool started;
+
+  pthread_attr_init (&attr);
+  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+  started = (pthread_create (&thread, &attr, worker, pool) == 0);
+  pthread_attr_destroy (&attr);
+
+  if (started)
+    pool->pp_refs++;
+  return started;
+}
+
+/* Run FUNC on the argument of each of the N PROBES, using at most WORKERS
+   threads at once.  The probes still running or pending TIMEOUT seconds
+   after the call (zero means no timeout) are given up and marked as
+   PROBE_TIMEDOUT; the other ones are marked as PROBE_DONE.  Return the
+   number of timed out probes.
+
+   Threads stuck in timed out probes are left running, so the arguments
+   of the timed out probes must never be released, nor reused.  */
+size_t
+run_probes (struct probe *probes, size_t n, void (*func) (void *),
+	    unsigned int workers, double timeout)
+{
+  struct probe_pool *pool;
+  struct timespec deadline;
+  size_t i, timedout = 0;
+  unsigned int w;
+
+  if (n == 0)
+    return 0;
+
+  /* Condition variables wait on the realtime clock.  */
+  if (timeout > 0)
+    {
+      double abstime = now (CLOCK_REALTIME) + timeout;
+
+      deadline.tv_sec = (time_t) abstime;
+      deadline.tv_nsec = (long) ((abstime - deadline.tv_sec) * 1e9);
+    }
+
+  pool = xmalloc (sizeof *pool);
+  pthread_mutex_init (&pool->pp_lock, NULL);
+  pthread_cond_init (&pool->pp_done, NULL);
+  pool->pp_probes = probes;
+  pool->pp_count = n;
+  pool->pp_next = pool->pp_finished = 0;
+  pool->pp_func = func;
+  pool->pp_refs = 1;
+  for (i = 0; i < n; i++)
+    probes[i].pr_state = PROBE_PENDING;
+
+  pthread_mutex_lock (&pool->pp_lock);
+
+  if (workers == 0)
+    workers = 1;
+  for (w = 0; w < workers && w < n; w++)
+    if (!start_worker (pool))
+      break;
+
+  /* If no thread can be created, run the probes by ourselves.  */
+  if (w == 0)
+    {
+      pthread_mutex_unlock (&pool->pp_lock);
+      for (i = 0; i < n; i++)
+	{
+	  double start = now (CLOCK_MONOTONIC);
+	  func (probes[i].pr_arg);
+	  probes[i].pr_elapsed = now (CLOCK_MONOTONIC) - start;
+	  probes[i].pr_state = PROBE_DONE;
+	}
+      pthread_mutex_lock (&pool->pp_lock);
+      pool->pp_next = pool->pp_finished = n;
+    }
+
+  while (pool->pp_finished < n)
+    {
+      if (timeout <= 0)
+	pthread_cond_wait (&pool->pp_done, &pool->pp_lock);
+      else if (pthread_cond_timedwait (&pool->pp_done, &pool->pp_lock,
+				       &deadline) == ETIMEDOUT)
+	{
+	  /* Give up the phase: no more probes are started.  */
+	  for (i = 0; i < n; i++)
+	    if (probes[i].pr_state != PROBE_DONE)
+	      {
+		probes[i].pr_state = PROBE_TIMEDOUT;
+		timedout++;
+	      }
+	  pool->pp_finished = pool->pp_next = n;
+	}
+    }
+
+  pool_unref (pool);
+  return timedout;
+}
@@ -0,0 +1,26 @@
+#ifndef _PROBE_H
+#define _PROBE_H        1
+
+# include <stddef.h>
+
+/* State of a probe.  */
+enum probe_state
+{
+  PROBE_PENDING,		/* Not started yet. */
+  PROBE_RUNNING,		/* Being run by a worker thread. */
+  PROBE_DONE,			/* Completed in time. */
+  PROBE_TIMEDOUT		/* Not done at the deadline of the phase. */
+};
+
+/* A probe: a possibly blocking operation run in a worker thread.  */
+struct probe
+{
+  void *pr_arg;			/* Argument of the probe function. */
+  enum probe_state pr_state;	/* Set by run_probes. */
+  double pr_elapsed;		/* Run time in seconds, if PROBE_DONE. */
+};
+
+size_t run_probes (struct probe *probes, size_t n, void (*func) (void *),
+		   unsigned int workers, double timeout);
+
+#endif /* probe.h */
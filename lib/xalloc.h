@@ -42,5 +42,7 @@ char *xstrdup (char const *str)
       _GL_ATTRIBUTE_MALLOC;
 void *xnmalloc (size_t n, size_t s)
       _GL_ATTRIBUTE_MALLOC _GL_ATTRIBUTE_ALLOC_SIZE ((1, 2));
+void *xrealloc (void *p, size_t s)
+      _GL_ATTRIBUTE_ALLOC_SIZE ((2));
 
 #endif /* !XALLOC_H_ */
@@ -34,6 +34,18 @@ xmalloc (size_t n)
   return p;
 }
 
+/* Change the size of an allocated block of memory P to N bytes,
+ *    with error checking.  */
+
+void *
+xrealloc (void *p, size_t n)
+{
+  p = realloc (p, n);
+  if (!p && n != 0)
+    perror ("memory exhausted");
+  return p;
+}
+
 /* Clone an object P of size S, with error checking.  There's no need
  *    for xnmemdup (P, N, S), since xmemdup (P, N * S) works without any
  *       need for an arithmetic overflow check.  */
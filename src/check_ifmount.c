@@ -30,6 +30,7 @@
 #include <mntent.h>
 #endif
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,8 +38,14 @@
 
 #include "common.h"
 #include "error.h"
+#include "mountd.h"
+#include "mountindex.h"
 #include "mountlist.h"
+#include "mounttrie.h"
 #include "nputils.h"
+#include "perfdata.h"
+#include "probe.h"
+#include "xalloc.h"
 
 #define STREQ(a, b) (strcmp (a, b) == 0)
 
@@ -50,7 +57,61 @@ static const char *program_copyright =
 /* Linked list of mounted file systems. */
 static struct mount_entry *mount_list;
 
+/* A mount point given as argument, and whether it was found in the mount
+   table.  */
+struct wanted_mount
+{
+  char const *wm_name;
+  bool wm_found;
+};
+
+/* The distinct mount points given as arguments, sorted by name, when the
+   mount table is searched as it is read.  */
+static struct wanted_mount *wanted;
+static size_t n_wanted;
+
+/* Number of the mount points in 'wanted' not found yet. */
+static size_t n_missing;
+
+/* Index over the mount points of 'mount_list'. */
+static struct mount_index *mount_index;
+
+/* Trie over the mount points of 'mount_list', used with -P. */
+static struct mount_trie *mount_trie;
+
+/* If true, the arguments can be any path, which is mounted if held by a
+   file system other than the root one.  */
+static bool path_mode;
+
+/* Arguments whose look by stat_entry timed out, which are not resolved
+   again by check_path, or NULL.  */
+static bool *stat_timedout;
+
+/* Deadline, in seconds, of the look at each argument by stat_entry, after
+   which the mount table is read instead, and maximum number of arguments
+   looked at once.  */
+#define STAT_TIMEOUT 5
+#define STAT_WORKERS 8
+
+/* If true, time the phases of the check and report them as performance
+   data.  */
+static bool show_perfdata;
+
+/* If not NULL, the file where to cache a snapshot of the mount table.  */
+static char *cache_file;
+
+/* If not NULL, the socket where to serve the queries as a daemon.  */
+static char *daemon_socket;
+
+/* If not NULL, the socket of the daemon to be queried.  */
+static char *query_socket;
+
 static struct option const longopts[] = {
+  {(char *) "path", no_argument, NULL, 'P'},
+  {(char *) "perfdata", no_argument, NULL, 'p'},
+  {(char *) "cache", required_argument, NULL, 'C'},
+  {(char *) "daemon", required_argument, NULL, 'D'},
+  {(char *) "socket", required_argument, NULL, 'S'},
   {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
   {(char *) "version", no_argument, NULL, GETOPT_VERSION_CHAR},
   {NULL, 0, NULL, 0}
@@ -62,7 +123,18 @@ static void __attribute__ ((__noreturn__)) usage (FILE * out)
 	   "%s, version %s - check whether the given filesystems are mounted.\n",
 	   program_name, program_version);
   fprintf (out, "%s\n\n", program_copyright);
-  fprintf (out, "Usage: %s [FILESYSTEM]...\n\n", program_name);
+  fprintf (out, "Usage: %s [OPTION]... [FILESYSTEM]...\n\n", program_name);
+  fputs ("\
+  -P, --path                accept any path as FILESYSTEM, which is mounted\n\
+                            if a file system other than / holds it\n\
+  -p, --perfdata            report the time of each phase of the check, the\n\
+                            number of entries and the peak memory use as\n\
+                            performance data\n\
+  -C, --cache=FILE          cache the mount table in FILE until it changes\n\
+  -D, --daemon=SOCKET       keep the mount table in memory and answer the\n\
+                            queries sent to the UNIX socket SOCKET\n\
+  -S, --socket=SOCKET       query the daemon listening on SOCKET, if any\n",
+	 out);
   fputs (HELP_OPTION_DESCRIPTION, out);
   fputs (VERSION_OPTION_DESCRIPTION, out);
 
@@ -76,58 +148,384 @@ print_version (void)
 	  program_copyright);
 }
 
+static int
+compare_wanted (void const *a, void const *b)
+{
+  return strcmp (((struct wanted_mount const *) a)->wm_name,
+		 ((struct wanted_mount const *) b)->wm_name);
+}
+
+/* Return the element of 'wanted' for the mount point MOUNTPOINT, or NULL
+   if it was not given as argument.  */
+static struct wanted_mount *
+find_wanted (char const *mountpoint)
+{
+  struct wanted_mount key;
+
+  key.wm_name = mountpoint;
+  return bsearch (&key, wanted, n_wanted, sizeof *wanted, compare_wanted);
+}
+
+/* Fill 'wanted' with the mount points given as arguments.  */
+static void
+init_wanted (int argc, char **argv)
+{
+  size_t i, n = argc - optind;
+
+  wanted = xnmalloc (n, sizeof *wanted);
+  for (i = 0; i < n; i++)
+    {
+      wanted[i].wm_name = argv[optind + i];
+      wanted[i].wm_found = false;
+    }
+  qsort (wanted, n, sizeof *wanted, compare_wanted);
+
+  /* Drop the duplicates.  */
+  for (n_wanted = 0, i = 0; i < n; i++)
+    if (n_wanted == 0 || !STREQ (wanted[i].wm_name,
+				 wanted[n_wanted - 1].wm_name))
+      wanted[n_wanted++] = wanted[i];
+  n_missing = n_wanted;
+}
+
+/* Called for each entry of the mount table: the walk is stopped as soon
+   as all the mount points given as arguments are found.  */
+static bool
+find_mount (struct mount_entry *me, void *arg)
+{
+  double start = perf_start ();
+  struct wanted_mount *wm = find_wanted (me->me_mountdir);
+
+  (void) arg;
+  perf_count (PERF_ENTRIES_READ, 1);
+  if (wm && !wm->wm_found)
+    {
+      wm->wm_found = true;
+      n_missing--;
+    }
+  perf_stop (PERF_LOOKUP, start);
+
+  return n_missing > 0;
+}
+
 static int
 check_entry (char const *mountpoint)
+{
+  size_t n;
+
+  if (wanted)
+    return find_wanted (mountpoint)->wm_found ? STATE_OK : STATE_CRITICAL;
+
+  mount_index_lookup (mount_index, mountpoint, &n);
+  return n ? STATE_OK : STATE_CRITICAL;
+}
+
+/* Tell whether the argument NAME is mounted, as check_entry would, by
+   looking at NAME itself rather than at the mount table.  The mount point
+   given to check_entry must be found as is in the table, whose paths are
+   canonical, so it must be canonical too.  With --path, only store in *ID
+   the ID of the mount holding NAME, to be compared by the caller with the
+   one holding "/", as check_path would.  NAME is never automounted, so
+   that the check does not change what it checks.  Return STATE_OK or
+   STATE_CRITICAL, or -1 if the mount table is needed.  */
+static int
+stat_entry (char const *name, uint64_t *id)
+{
+  bool root;
+  char *path;
+
+  if (path_mode)
+    return file_mount_state (name, true, &root, id) == 0 ? STATE_OK : -1;
+
+  path = realpath (name, NULL);
+  if (path == NULL)
+    return (errno == ENOENT || errno == ENOTDIR) ? STATE_CRITICAL : -1;
+  root = STREQ (path, name);
+  free (path);
+  if (!root)
+    return STATE_CRITICAL;
+
+  if (file_mount_state (name, false, &root, id) != 0)
+    return -1;
+  return root ? STATE_OK : STATE_CRITICAL;
+}
+
+/* A look at an argument by stat_entry, run as a probe.  */
+struct stat_probe
+{
+  char const *sp_name;
+  uint64_t sp_id;
+  int sp_state;
+};
+
+static void
+run_stat_probe (void *arg)
+{
+  struct stat_probe *sp = arg;
+
+  sp->sp_state = stat_entry (sp->sp_name, &sp->sp_id);
+}
+
+/* Check that the file NAME is held by a mounted file system other than
+   the root one.  NAME is only resolved if RESOLVE is true.  */
+static int
+check_path (char const *name, bool resolve)
 {
   struct mount_entry *me;
+  char *path = resolve ? realpath (name, NULL) : NULL;
 
-  for (me = mount_list; me; me = me->me_next)
-    if (STREQ (me->me_mountdir, mountpoint))
-      return STATE_OK;
+  me = mount_trie_lookup (mount_trie, path ? path : name);
+  free (path);
 
-  return STATE_CRITICAL;
+  return (me && !STREQ (me->me_mountdir, "/")) ? STATE_OK : STATE_CRITICAL;
 }
 
-int
-main (int argc, char **argv)
+static void
+parse_options (int argc, char **argv)
 {
-  int c, status = STATE_OK;
+  int c;
+
+  path_mode = false;
+  show_perfdata = false;
+  cache_file = NULL;
+  daemon_socket = NULL;
+  query_socket = NULL;
 
-  while ((c = getopt_long (argc, argv, "hv", longopts, NULL)) != -1)
+  /* Also parse again from scratch when called by the daemon.  */
+  optind = 0;
+
+  while ((c = getopt_long (argc, argv, "PpC:D:S:hv", longopts, NULL)) != -1)
     {
       switch (c)
 	{
 	default:
 	  usage (stderr);
 	  break;
+	case 'P':
+	  path_mode = true;
+	  break;
+	case 'p':
+	  show_perfdata = true;
+	  break;
+	case 'C':
+	  cache_file = optarg;
+	  break;
+	case 'D':
+	  daemon_socket = optarg;
+	  break;
+	case 'S':
+	  query_socket = optarg;
+	  break;
 
 	case_GETOPT_HELP_CHAR
 	case_GETOPT_VERSION_CHAR
 
 	}
     }
+}
+
+/* Print the plugin output for STATUS, and return it.  */
+static int
+report_status (int status)
+{
+  double start = perf_start ();
+
+  if (status == STATE_OK)
+    fputs ("FILESYSTEMS OK", stdout);
+  perf_stop (PERF_OUTPUT, start);
+  if (show_perfdata)
+    {
+      /* After the lines of the file systems not mounted, if any.  */
+      fputs (status == STATE_OK ? " |" : "|", stdout);
+      perf_print (stdout);
+    }
+  if (status == STATE_OK || show_perfdata)
+    putchar ('\n');
+
+  return status;
+}
+
+/* Check the arguments with stat_entry, without the mount table.  The
+   arguments are looked at concurrently, along with "/" with --path, and
+   the mount table is needed if any of them cannot be looked at or times
+   out, as a hung network file system would.  Return the status of the
+   check, or -1 if the mount table is needed, in which case the arguments
+   that timed out are flagged in 'stat_timedout'.  */
+static int
+stat_filesystems (int argc, char **argv)
+{
+  size_t i, n = argc - optind, timedout;
+  struct stat_probe *sps;
+  struct probe *probes;
+  int status = STATE_OK;
+  double start = perf_start ();
+
+  sps = xnmalloc (n + 1, sizeof *sps);
+  probes = xnmalloc (n + 1, sizeof *probes);
+  for (i = 0; i < n + 1; i++)
+    {
+      sps[i].sp_name = (i < n) ? argv[optind + i] : "/";
+      sps[i].sp_state = -1;
+      probes[i].pr_arg = &sps[i];
+    }
+
+  timedout = run_probes (probes, n + path_mode, run_stat_probe,
+			 STAT_WORKERS, STAT_TIMEOUT);
+  perf_stop (PERF_LOOKUP, start);
+
+  for (i = 0; i < n + path_mode; i++)
+    if (probes[i].pr_state == PROBE_TIMEDOUT || sps[i].sp_state < 0)
+      status = -1;
+
+  if (timedout > 0)
+    {
+      stat_timedout = xnmalloc (n, sizeof *stat_timedout);
+      for (i = 0; i < n; i++)
+	stat_timedout[i] = (probes[i].pr_state == PROBE_TIMEDOUT);
+      /* The threads stuck in timed out looks may still write to them.  */
+      return -1;
+    }
+
+  for (i = 0; i < n && status == STATE_OK; i++)
+    if (path_mode && sps[i].sp_id == sps[n].sp_id)
+      sps[i].sp_state = STATE_CRITICAL;
+  free (probes);
+  if (status < 0)
+    {
+      free (sps);
+      return -1;
+    }
+
+  for (i = 0; i < n; i++)
+    if (sps[i].sp_state == STATE_CRITICAL)
+      {
+	printf ("FILESYSTEM CRITICAL: `%s' not mounted\n", argv[optind + i]);
+	status = STATE_CRITICAL;
+      }
+
+  free (sps);
+  return report_status (status);
+}
+
+static int
+check_filesystems (int argc, char **argv)
+{
+  int status = STATE_OK;
+  bool cached;
+  double start;
+
+  perf_enable (show_perfdata);
+  start = perf_start ();
+  mount_list = mountd_mount_list (&mount_index);
+  cached = (mount_list != NULL);
+  set_mount_list_cache (cache_file);
+
+  /* Unless the daemon has the table, each argument is looked at by
+     itself first, and the table is only read if this fails.  */
+  if (!cached && optind < argc)
+    {
+      status = stat_filesystems (argc, argv);
+      if (status >= 0)
+	return status;
+      status = STATE_OK;
+      start = perf_start ();
+    }
 
-  mount_list = read_file_system_list (false);
+  /* Without daemon or cache, the mount points are searched as the table
+     is read, which is only read up to the last one found.  */
+  if (!cached && !cache_file && !path_mode && optind < argc)
+    {
+      init_wanted (argc, argv);
+      if (walk_file_system_list (MOUNT_FIELD_MOUNTDIR, find_mount, NULL) < 0)
+	/* Couldn't read the table of mounted file systems. */
+	error (STATE_UNKNOWN, 0, "cannot read table of mounted file systems\n");
+      perf_stop (PERF_READ, start);
+      perf_discount (PERF_READ, PERF_LOOKUP);
+    }
+  else
+    {
+      if (!cached)
+	mount_list = read_file_system_list (MOUNT_FIELD_MOUNTDIR);
 
-  if (NULL == mount_list)
-    /* Couldn't read the table of mounted file systems. */
-    error (STATE_UNKNOWN, 0, "cannot read table of mounted file systems\n");
+      if (NULL == mount_list)
+	/* Couldn't read the table of mounted file systems. */
+	error (STATE_UNKNOWN, 0, "cannot read table of mounted file systems\n");
+      perf_stop (PERF_READ, start);
+
+      if (perf_enabled ())
+	{
+	  struct mount_entry *me;
+
+	  for (me = mount_list; me; me = me->me_next)
+	    perf_count (PERF_ENTRIES_READ, 1);
+	}
+    }
 
   if (optind < argc)
     {
       int i;
+
+      start = perf_start ();
+      if (path_mode)
+	mount_trie = mount_trie_new (mount_list);
+      else if (!cached && !wanted)
+	mount_index = mount_index_new (mount_list);
       for (i = optind; i < argc; ++i)
-	if (check_entry (argv[i]) == STATE_CRITICAL)
+	if ((path_mode
+	     ? check_path (argv[i], !stat_timedout || !stat_timedout[i - optind])
+	     : check_entry (argv[i])) == STATE_CRITICAL)
 	  {
 	    printf ("FILESYSTEM CRITICAL: `%s' not mounted\n", argv[i]);
 	    status = STATE_CRITICAL;
 	  }
+      perf_stop (PERF_LOOKUP, start);
     }
   else
     usage (stderr);
 
-  if (status == STATE_OK)
-    printf ("FILESYSTEMS OK\n");
+  status = report_status (status);
 
+  mount_trie_free (mount_trie);
+  mount_trie = NULL;
+  free (wanted);
+  wanted = NULL;
+  free (stat_timedout);
+  stat_timedout = NULL;
+  if (!cached)
+    {
+      mount_index_free (mount_index);
+      free_mount_list (mount_list);
+    }
   return status;
 }
+
+/* Answer a query sent to the daemon.  */
+static int
+daemon_query (int argc, char **argv)
+{
+  parse_options (argc, argv);
+  return check_filesystems (argc, argv);
+}
+
+int
+main (int argc, char **argv)
+{
+  parse_options (argc, argv);
+
+  if (daemon_socket)
+    {
+      mountd_serve (daemon_socket, daemon_query);
+      error (STATE_UNKNOWN, errno, "cannot serve queries on `%s'\n",
+	     daemon_socket);
+    }
+
+  if (query_socket)
+    {
+      /* Do the check by ourselves if the daemon is not running.  */
+      int status = mountd_query (query_socket, argc, argv);
+      if (status >= 0)
+	return status;
+    }
+
+  return check_filesystems (argc, argv);
+}
@@ -30,18 +30,35 @@
 #include <mntent.h>
 #endif
 
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#if HAVE_SYS_STATVFS_H
+#include <sys/statvfs.h>
+#endif
+#include <time.h>
 #include <unistd.h>
 
 #include "common.h"
 #include "error.h"
+#include "fstypeset.h"
+#include "mountd.h"
+#include "mountindex.h"
 #include "mountlist.h"
+#include "mountns.h"
+#include "mounttable.h"
+#include "mounttrie.h"
 #include "nputils.h"
+#include "pathset.h"
+#include "perfdata.h"
+#include "probe.h"
 #include "xalloc.h"
 
 #define STREQ(a, b) (strcmp (a, b) == 0)
@@ -51,34 +68,41 @@ static const char *program_version = PACKAGE_VERSION;
 static const char *program_copyright =
   "Copyright (C) 2013 Davide Madrisan <" PACKAGE_BUGREPORT ">";
 
-/* A file system type to display. */
-
-struct fs_type_list
-{
-  char *fs_name;
-  struct fs_type_list *fs_next;
-};
-
-/* Linked list of file system types to display.
- * If 'fs_select_list' is NULL, list all types.
- * This table is generated dynamically from command-line options,
+/* Set of file system types to display.
+ * If 'fs_select_set' is NULL, list all types.
+ * This set is generated dynamically from command-line options,
  * rather than hardcoding into the program what it thinks are the
  * valid file system types; let the user specify any file system type
  * they want to, and if there are any file systems of that type, they
- * will be shown.
+ * will be shown.  Glob patterns like 'fuse.*' are also accepted.
  *
  * Some file system types:
  * 4.2 4.3 ufs nfs swap ignore io vm efs dbg */
 
-static struct fs_type_list *fs_select_list;
+static struct fstype_set *fs_select_set;
+
+/* Set of file system types to omit.
+ *    If the set is NULL, don't exclude any types.  */
+static struct fstype_set *fs_exclude_set;
 
-/* Linked list of file system types to omit.
- *    If the list is empty, don't exclude any types.  */
-static struct fs_type_list *fs_exclude_list;
+/* Sets of mount points to display and to omit, given as absolute file
+   names or glob patterns, each also matching the mount points below it.
+   If a set is NULL, don't select or exclude any mount point.  */
+static struct path_set *path_select_set;
+static struct path_set *path_exclude_set;
 
 /* Linked list of mounted file systems. */
 static struct mount_entry *mount_list;
 
+/* Index over the mount points of 'mount_list'. */
+static struct mount_index *mount_index;
+
+/* Compact layout of 'mount_list', if kept by the daemon, or NULL.  */
+static struct mount_table *mount_table;
+
+/* Trie over the mount points of 'mount_list', or NULL if not built yet. */
+static struct mount_trie *mount_trie;
+
 /* If true, show even file systems with zero size or
    uninteresting types. */
 static bool show_all_fs;
@@ -90,28 +114,133 @@ static bool show_local_fs;
    command line arguments.  */
 static bool show_listed_fs;
 
+/* If true, confirm the readonly state of the checked file systems
+   with statvfs.  */
+static bool verify_fs;
+
+/* If true, check that the file systems not found readonly can actually
+   be written, by writing a temporary file in each of them.  */
+static bool write_fs;
+
+/* Directory, relative to each mount point, where the temporary file of a
+   write probe is created.  */
+static char const *write_probe_dir;
+
+/* Deadline, in seconds, of the automount triggers, of the statvfs probes
+   and of the write probes, each phase as a whole.  */
+static double probe_timeout;
+
+/* Maximum number of statvfs probes, write probes or namespace reads
+   running at once.  */
+static unsigned int probe_workers;
+
+/* Number of timed out statvfs probes, and wall time of the probe phase,
+   in seconds.  */
+static size_t probe_timeouts;
+static double probe_time;
+
+/* The write probes, sorted by mount entry, the number of file systems
+   found not writable, the number of timed out write probes, and the wall
+   time of the write probe phase, in seconds.  */
+struct write_probe;
+static struct write_probe *write_probes;
+static size_t n_write_probes;
+static size_t write_failures;
+static size_t write_timeouts;
+static double write_time;
+
+/* If true, check the file systems of every mount namespace.  */
+static bool scan_namespaces;
+
+/* If true, look at the command line arguments without triggering their
+   automount, and report the ones not mounted.  */
+static bool no_automount;
+
+/* Command line arguments held by an automount point not mounted, with
+   --no-automount.  */
+static char const **unmounted_fs;
+static size_t n_unmounted_fs;
+
+/* If true, wait for a checked file system to turn readonly.  */
+static bool watch_fs;
+
+/* If not NULL, the shell command run, with the mount points as arguments,
+   each time checked file systems turn readonly, instead of exiting.  */
+static char const *watch_command;
+
+/* If true, time the phases of the check and report them as performance
+   data.  */
+static bool show_perfdata;
+
+/* Number of readonly file systems reported so far.  */
+static size_t n_readonly_fs;
+
+/* Device numbers of the file systems holding the command line arguments,
+   as found by the automount triggers, or -1 when unknown.  */
+static dev_t *argument_devs;
+
+/* Unique IDs of the mounts holding the command line arguments, as found
+   by the automount triggers, or 0 when unknown, and their entries, when
+   only these mounts were read, or NULL.  */
+static uint64_t *argument_ids;
+static struct mount_entry **argument_mounts;
+
+/* Mount points of the checked file systems whose state is unknown, as
+   their probes timed out.  */
+static char const **unknown_fs;
+static size_t n_unknown_fs;
+
+/* Mount namespaces whose mount table could not be read, with -N.  */
+static char const **unreadable_fs;
+static size_t n_unreadable_fs;
+
+/* Maximum number of automount triggers running at once.  */
+#define MAX_TRIGGER_WORKERS 256
+
+/* If not NULL, the file where to cache a snapshot of the mount table.  */
+static char *cache_file;
+
+/* If not NULL, the socket where to serve the queries as a daemon.  */
+static char *daemon_socket;
+
+/* If not NULL, the socket of the daemon to be queried.  */
+static char *query_socket;
+
+static char const short_options[] = "alLT:X:I:E:Nnsw::t:j:We:pC:D:S:hv";
+
 static struct option const longopts[] = {
   {(char *) "all", no_argument, NULL, 'a'},
   {(char *) "local", no_argument, NULL, 'l'},
   {(char *) "list", no_argument, NULL, 'L'},
   {(char *) "type", required_argument, NULL, 'T'},
   {(char *) "exclude-type", required_argument, NULL, 'X'},
+  {(char *) "include-path", required_argument, NULL, 'I'},
+  {(char *) "exclude-path", required_argument, NULL, 'E'},
+  {(char *) "namespaces", no_argument, NULL, 'N'},
+  {(char *) "no-automount", no_argument, NULL, 'n'},
+  {(char *) "statvfs", no_argument, NULL, 's'},
+  {(char *) "write", optional_argument, NULL, 'w'},
+  {(char *) "timeout", required_argument, NULL, 't'},
+  {(char *) "jobs", required_argument, NULL, 'j'},
+  {(char *) "watch", no_argument, NULL, 'W'},
+  {(char *) "exec", required_argument, NULL, 'e'},
+  {(char *) "perfdata", no_argument, NULL, 'p'},
+  {(char *) "cache", required_argument, NULL, 'C'},
+  {(char *) "daemon", required_argument, NULL, 'D'},
+  {(char *) "socket", required_argument, NULL, 'S'},
   {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
   {(char *) "version", no_argument, NULL, GETOPT_VERSION_CHAR},
   {NULL, 0, NULL, 0}
 };
 
-/* Add FSTYPE to the list of file system types to display. */
+/* Add FSTYPE to the set of file system types to display. */
 
 static void
 add_fs_type (const char *fstype)
 {
-  struct fs_type_list *fsp;
-
-  fsp = xmalloc (sizeof *fsp);
-  fsp->fs_name = (char *) fstype;
-  fsp->fs_next = fs_select_list;
-  fs_select_list = fsp;
+  if (fs_select_set == NULL)
+    fs_select_set = fstype_set_new ();
+  fstype_set_add (fs_select_set, fstype);
 }
 
 /* Is FSTYPE a type of file system that should be listed?  */
@@ -119,27 +248,19 @@ add_fs_type (const char *fstype)
 static bool
 selected_fstype (const char *fstype)
 {
-  const struct fs_type_list *fsp;
-
-  if (fs_select_list == NULL || fstype == NULL)
+  if (fs_select_set == NULL || fstype == NULL)
     return true;
-  for (fsp = fs_select_list; fsp; fsp = fsp->fs_next)
-    if (STREQ (fstype, fsp->fs_name))
-      return true;
-  return false;
+  return fstype_set_match (fs_select_set, fstype);
 }
 
-/* Add FSTYPE to the list of file system types to be omitted. */
+/* Add FSTYPE to the set of file system types to be omitted. */
 
 static void
 add_excluded_fs_type (const char *fstype)
 {
-  struct fs_type_list *fsp;
-
-  fsp = xmalloc (sizeof *fsp);
-  fsp->fs_name = (char *) fstype;
-  fsp->fs_next = fs_exclude_list;
-  fs_exclude_list = fsp;
+  if (fs_exclude_set == NULL)
+    fs_exclude_set = fstype_set_new ();
+  fstype_set_add (fs_exclude_set, fstype);
 }
 
 /* Is FSTYPE a type of file system that should be omitted?  */
@@ -147,14 +268,50 @@ add_excluded_fs_type (const char *fstype)
 static bool
 excluded_fstype (const char *fstype)
 {
-  const struct fs_type_list *fsp;
+  if (fs_exclude_set == NULL || fstype == NULL)
+    return false;
+  return fstype_set_match (fs_exclude_set, fstype);
+}
+
+/* Add PATTERN to the set SET of mount points, which is created if
+   NULL.  */
+
+static void
+add_path_pattern (struct path_set **set, char const *pattern)
+{
+  if (*pattern != '/')
+    error (STATE_UNKNOWN, 0, "mount point `%s' is not an absolute file name\n",
+	   pattern);
+  if (*set == NULL)
+    *set = path_set_new ();
+  path_set_add (*set, pattern);
+}
 
-  if (fs_exclude_list == NULL || fstype == NULL)
+/* Is DIR a mount point that should be listed?  */
+
+static bool
+selected_path (char const *dir)
+{
+  if (path_select_set && !path_set_match (path_select_set, dir))
     return false;
-  for (fsp = fs_exclude_list; fsp; fsp = fsp->fs_next)
-    if (STREQ (fstype, fsp->fs_name))
-      return true;
-  return false;
+  return !(path_exclude_set && path_set_match (path_exclude_set, dir));
+}
+
+/* Add NAME to the list of file systems whose state is unknown.  */
+
+static void
+add_unknown_fs (char const *name)
+{
+  unknown_fs = xrealloc (unknown_fs, (n_unknown_fs + 1) * sizeof *unknown_fs);
+  unknown_fs[n_unknown_fs++] = name;
+}
+
+/* Is ME an automount point, not mounted yet?  */
+
+static bool
+automount_entry (struct mount_entry const *me)
+{
+  return me->me_type && STREQ (me->me_type, "autofs");
 }
 
 static bool
@@ -169,59 +326,717 @@ skip_mount_entry (struct mount_entry *me)
   if (!selected_fstype (me->me_type) || excluded_fstype (me->me_type))
     return true;
 
+  if (!selected_path (me->me_mountdir))
+    return true;
+
   return false;
 }
 
+/* Return the MOUNT_FIELD_* fields of the mount entries used by the
+   check.  */
+static unsigned int
+mount_fields (void)
+{
+  unsigned int fields = MOUNT_FIELD_MOUNTDIR | MOUNT_FIELD_DEV
+    | MOUNT_FIELD_FLAGS | MOUNT_FIELD_CLASS;
+
+  if (fs_select_set || fs_exclude_set || no_automount)
+    fields |= MOUNT_FIELD_TYPE;
+  if (show_listed_fs)
+    fields |= MOUNT_FIELD_DEVNAME | MOUNT_FIELD_TYPE | MOUNT_FIELD_OPTS;
+
+  return fields;
+}
+
+static char const *write_probe_state (struct mount_entry const *me);
+
+/* Print the line of ME in the list of the checked file systems.  */
+static void
+list_mount_entry (struct mount_entry const *me)
+{
+  char const *state = write_probe_state (me);
+
+  if (state == NULL)
+    state = (me->me_readonly) ? "<< read-only"
+      : (me->me_unknown) ? "<< timed out" : "";
+  printf ("%-10s %s type %s (%s) %s\n",
+	  me->me_devname, me->me_mountdir, me->me_type, me->me_opts, state);
+}
+
+/* Report the state of the file system ME, which is to be checked, and
+   return STATE_CRITICAL if it is readonly, STATE_OK otherwise.  */
+static int
+check_mount_entry (struct mount_entry *me)
+{
+  if (show_listed_fs)
+    list_mount_entry (me);
+  else if (me->me_readonly)
+    printf ("%s%s", n_readonly_fs == 0 ? "FILESYSTEMS CRITICAL: " : ",",
+	    me->me_mountdir);
+
+  if (me->me_readonly)
+    {
+      n_readonly_fs++;
+      return STATE_CRITICAL;
+    }
+  if (me->me_unknown)
+    add_unknown_fs (me->me_mountdir);
+
+  return STATE_OK;
+}
+
+/* Check the file systems of the compact table TABLE.  The entries to be
+   checked are selected a word of entries at a time, and unless they are
+   all listed, only the readonly and unknown ones are visited.  */
+static int
+check_table_entries (struct mount_table const *table)
+{
+  uint64_t *bits = xnmalloc (table->mt_words ? table->mt_words : 1,
+			     sizeof *bits);
+  int status = STATE_OK;
+  size_t i, w;
+
+  mount_table_select (table, show_local_fs, show_all_fs,
+		      fs_select_set, fs_exclude_set, bits);
+  mount_table_select_paths (table, path_select_set, path_exclude_set, bits);
+  if (perf_enabled ())
+    {
+      size_t selected = 0;
+
+      for (i = mount_table_next (table, bits, 0); i < table->mt_count;
+	   i = mount_table_next (table, bits, i + 1))
+	selected++;
+      perf_count (PERF_ENTRIES_READ, table->mt_count);
+      perf_count (PERF_ENTRIES_SKIPPED, table->mt_count - selected);
+    }
+  if (!show_listed_fs)
+    for (w = 0; w < table->mt_words; w++)
+      bits[w] &= table->mt_readonly[w] | table->mt_unknown[w];
+
+  for (i = mount_table_next (table, bits, 0); i < table->mt_count;
+       i = mount_table_next (table, bits, i + 1))
+    if (check_mount_entry (table->mt_entries[i]) == STATE_CRITICAL)
+      status = STATE_CRITICAL;
+
+  free (bits);
+  return status;
+}
+
 static int
 check_all_entries (void)
 {
   struct mount_entry *me;
   int status = STATE_OK;
 
+  if (mount_table)
+    return check_table_entries (mount_table);
+
   for (me = mount_list; me; me = me->me_next)
     {
+      perf_count (PERF_ENTRIES_READ, 1);
       if (skip_mount_entry (me))
-	continue;
-
-      if (show_listed_fs)
-	printf ("%-10s %s type %s (%s) %s\n",
-		me->me_devname, me->me_mountdir, me->me_type, me->me_opts,
-		(me->me_readonly) ? "<< read-only" : "");
-      else if (me->me_readonly && (status == STATE_OK))
-	printf ("FILESYSTEMS CRITICAL: %s", me->me_mountdir);
-      else if (me->me_readonly)
-	printf (",%s", me->me_mountdir);
-
-      if (me->me_readonly)
+	perf_count (PERF_ENTRIES_SKIPPED, 1);
+      else if (check_mount_entry (me) == STATE_CRITICAL)
 	status = STATE_CRITICAL;
     }
 
   return status;
 }
 
-static int
-check_entry (char const *name)
+/* Called for each entry of the mount table when the file systems are
+   checked as the table is read.  */
+static bool
+check_walked_entry (struct mount_entry *me, void *arg)
+{
+  int *status = arg;
+  double start = perf_start ();
+
+  perf_count (PERF_ENTRIES_READ, 1);
+  if (skip_mount_entry (me))
+    perf_count (PERF_ENTRIES_SKIPPED, 1);
+  else if (check_mount_entry (me) == STATE_CRITICAL)
+    *status = STATE_CRITICAL;
+  perf_stop (PERF_FILTER, start);
+
+  return true;
+}
+
+/* Return the entry of the mount holding the file NAME, found with the
+   trie over the mount points, or NULL if there is none.  The trie is only
+   built the first time it is needed.  */
+static struct mount_entry *
+lookup_path (char const *name)
 {
   struct mount_entry *me;
+  char *path = realpath (name, NULL);
 
-  for (me = mount_list; me; me = me->me_next)
-    if (STREQ (me->me_mountdir, name))
-      {
-	if (skip_mount_entry (me))
-	  return STATE_OK;
+  if (mount_trie == NULL)
+    mount_trie = mount_trie_new (mount_list);
+  me = mount_trie_lookup (mount_trie, path ? path : name);
+  free (path);
+
+  return me;
+}
+
+/* Return the entry of the file system holding the command line argument
+   ARGV[ARG], or NULL if there is none.  The device number of the argument
+   only narrows the candidates: a device is mounted more than once with
+   bind mounts or btrfs subvolumes, and a file of an overlayfs reports the
+   device of its lower layer.  So the mount is picked among them by its
+   unique ID when both the table and the automount trigger know it, and is
+   looked up by path otherwise, which also picks the visible one among
+   over-mounts.  */
+static struct mount_entry *
+resolve_argument (char **argv, int arg)
+{
+  dev_t dev = argument_devs[arg - optind];
+  uint64_t id = argument_ids[arg - optind];
+  struct mount_entry **entries, *me;
+  size_t i, n;
 
-	if (show_listed_fs)
-	  printf ("%-10s %s type %s (%s) %s\n",
-		  me->me_devname, me->me_mountdir, me->me_type, me->me_opts,
-		  (me->me_readonly) ? "<< read-only" : "");
+  if (argument_mounts)
+    return argument_mounts[arg - optind];
 
-	if (me->me_readonly)
-	  return STATE_CRITICAL;
-      }
+  entries = mount_index_lookup_dev (mount_index, dev, &n);
+  if (id != 0)
+    for (i = 0; i < n; i++)
+      if (entries[i]->me_mnt_id == id)
+	return entries[i];
+
+  me = lookup_path (argv[arg]);
+  if (me == NULL && n > 0)
+    me = entries[n - 1];
+
+  return me;
+}
+
+static int
+check_entry (char **argv, int arg)
+{
+  struct mount_entry *me = resolve_argument (argv, arg);
+
+  /* Without the automount, the argument is held by the autofs file
+     system.  */
+  if (me && no_automount && automount_entry (me))
+    {
+      if (show_listed_fs)
+	printf ("%-10s %s type %s << not currently mounted\n",
+		me->me_devname, argv[arg], me->me_type);
+      unmounted_fs = xrealloc (unmounted_fs, (n_unmounted_fs + 1)
+			       * sizeof *unmounted_fs);
+      unmounted_fs[n_unmounted_fs++] = argv[arg];
+      return STATE_OK;
+    }
+
+  if (me == NULL || skip_mount_entry (me))
+    {
+      perf_count (PERF_ENTRIES_SKIPPED, 1);
+      return STATE_OK;
+    }
+
+  if (show_listed_fs)
+    list_mount_entry (me);
+
+  if (me->me_readonly)
+    return STATE_CRITICAL;
+  if (me->me_unknown)
+    return STATE_UNKNOWN;
 
   return STATE_OK;
 }
 
+/* An automount trigger: the opening of a file given on the command line,
+   or only its stat with --no-automount.  */
+struct trigger_probe
+{
+  char const *tp_name;
+  struct stat tp_stat;
+  uint64_t tp_mnt_id;
+  bool tp_ok;
+};
+
+static void
+run_trigger_probe (void *arg)
+{
+  struct trigger_probe *tp = arg;
+
+  /* Prefer to open with O_NOCTTY and use fstat, but fall back
+   * on using "stat", in case the file is unreadable.  */
+  int fd = open (tp->tp_name, O_RDONLY | O_NOCTTY);
+  tp->tp_ok = !((fd < 0 || fstat (fd, &tp->tp_stat))
+		&& stat (tp->tp_name, &tp->tp_stat));
+  if (!tp->tp_ok
+      || file_mount_id (fd, fd < 0 ? tp->tp_name : NULL, &tp->tp_mnt_id) != 0)
+    tp->tp_mnt_id = 0;
+  if (0 <= fd)
+    close (fd);
+}
+
+#ifdef AT_NO_AUTOMOUNT
+static void
+run_stat_probe (void *arg)
+{
+  struct trigger_probe *tp = arg;
+
+  tp->tp_ok = (fstatat (AT_FDCWD, tp->tp_name, &tp->tp_stat,
+			AT_NO_AUTOMOUNT) == 0);
+  if (!tp->tp_ok || file_mount_id (-1, tp->tp_name, &tp->tp_mnt_id) != 0)
+    tp->tp_mnt_id = 0;
+}
+#endif
+
+/* Open each of the given entries to make sure any corresponding
+ * partition is automounted.  This must be done before reading the
+ * file system table.  The entries are opened concurrently, and the ones
+ * still pending after the timeout are reported as unknown.  With
+ * --no-automount they are only looked at, which still triggers the
+ * automount of their parent directories, though.  */
+
+static void
+trigger_automounts (int argc, char **argv)
+{
+  size_t i, n = argc - optind, timedout;
+  struct trigger_probe *tps;
+  struct probe *probes;
+
+  tps = xnmalloc (n, sizeof *tps);
+  probes = xnmalloc (n, sizeof *probes);
+  argument_devs = xnmalloc (n, sizeof *argument_devs);
+  argument_ids = xnmalloc (n, sizeof *argument_ids);
+  for (i = 0; i < n; i++)
+    {
+      tps[i].tp_name = argv[optind + i];
+      tps[i].tp_ok = false;
+      probes[i].pr_arg = &tps[i];
+      argument_devs[i] = (dev_t) -1;
+      argument_ids[i] = 0;
+    }
+
+  timedout = run_probes (probes, n,
+#ifdef AT_NO_AUTOMOUNT
+			 no_automount ? run_stat_probe :
+#endif
+			 run_trigger_probe,
+			 n < MAX_TRIGGER_WORKERS ? n : MAX_TRIGGER_WORKERS,
+			 probe_timeout);
+
+  for (i = 0; i < n; i++)
+    {
+      char *name = argv[optind + i];
+
+      if (probes[i].pr_state == PROBE_TIMEDOUT)
+	{
+	  error (0, 0, "timed out while opening `%s'\n", name);
+	  add_unknown_fs (name);
+	  argv[optind + i] = NULL;
+	}
+      else if (!tps[i].tp_ok)
+	{
+	  error (0, 0, "cannot open `%s'\n", name);
+	  argv[optind + i] = NULL;
+	}
+      /* A device node stands for the file system it holds.  */
+      else if (S_ISBLK (tps[i].tp_stat.st_mode))
+	argument_devs[i] = tps[i].tp_stat.st_rdev;
+      else
+	{
+	  argument_devs[i] = tps[i].tp_stat.st_dev;
+	  argument_ids[i] = tps[i].tp_mnt_id;
+	}
+    }
+
+  /* The threads stuck in timed out triggers may still write to them.  */
+  if (timedout == 0)
+    {
+      free (tps);
+      free (probes);
+    }
+}
+
+static int
+compare_ids (void const *a, void const *b)
+{
+  uint64_t ia = *(uint64_t const *) a;
+  uint64_t ib = *(uint64_t const *) b;
+
+  return (ia > ib) - (ia < ib);
+}
+
+/* Read by their unique IDs only the entries of the mounts holding the
+   command line arguments, rather than the whole mount table, and store
+   in argument_mounts the entry of each argument.  Return the list of the
+   entries, or NULL if the mount of an argument is unknown, as for a
+   device node, or cannot be read this way, in which case the whole table
+   is to be read.  */
+
+static struct mount_entry *
+read_argument_mounts (int argc, char **argv)
+{
+  size_t i, n = 0, count = argc - optind;
+  struct mount_entry *list, *me, **entries;
+  uint64_t *ids;
+
+  ids = xnmalloc (count, sizeof *ids);
+  for (i = 0; i < count; i++)
+    {
+      if (argv[optind + i] == NULL)
+	continue;
+      if (argument_ids[i] == 0)
+	{
+	  free (ids);
+	  return NULL;
+	}
+      ids[n++] = argument_ids[i];
+    }
+
+  /* Each mount is read once.  */
+  qsort (ids, n, sizeof *ids, compare_ids);
+  for (i = 0, count = n, n = 0; i < count; i++)
+    if (n == 0 || ids[i] != ids[n - 1])
+      ids[n++] = ids[i];
+
+  list = (n > 0) ? read_mount_entries (ids, n, mount_fields ()) : NULL;
+  if (list == NULL)
+    {
+      free (ids);
+      return NULL;
+    }
+
+  entries = xnmalloc (n, sizeof *entries);
+  for (me = list, i = 0; me; me = me->me_next)
+    entries[i++] = me;
+
+  count = argc - optind;
+  argument_mounts = xnmalloc (count, sizeof *argument_mounts);
+  for (i = 0; i < count; i++)
+    {
+      uint64_t *id = NULL;
+
+      if (argv[optind + i])
+	id = bsearch (&argument_ids[i], ids, n, sizeof *ids, compare_ids);
+      argument_mounts[i] = id ? entries[id - ids] : NULL;
+    }
+
+  free (entries);
+  free (ids);
+  return list;
+}
+
+/* Return an array of the mount entries to be checked, and store their
+   number in *N: the ones holding the command line arguments, if any, and
+   all the ones not skipped otherwise.  */
+
+static struct mount_entry **
+checked_entries (int argc, char **argv, size_t *n)
+{
+  struct mount_entry *me, **entries;
+  size_t max = 0;
+
+  for (me = mount_list; me; me = me->me_next)
+    max++;
+  entries = xnmalloc (max ? max : 1, sizeof *entries);
+  *n = 0;
+
+  if (optind < argc)
+    {
+      int arg;
+      for (arg = optind; arg < argc; arg++)
+	{
+	  if (argv[arg] == NULL)
+	    continue;
+	  me = resolve_argument (argv, arg);
+	  if (me && !skip_mount_entry (me) && *n < max)
+	    entries[(*n)++] = me;
+	}
+    }
+  else
+    for (me = mount_list; me; me = me->me_next)
+      if (!skip_mount_entry (me))
+	entries[(*n)++] = me;
+
+  /* Probing an automount point would mount it.  */
+  if (no_automount)
+    {
+      size_t i, count = *n;
+
+      for (i = 0, *n = 0; i < count; i++)
+	if (!automount_entry (entries[i]))
+	  entries[(*n)++] = entries[i];
+    }
+
+  return entries;
+}
+
+/* Return the wall time elapsed since START, in seconds.  */
+
+static double
+elapsed_since (struct timespec const *start)
+{
+  struct timespec end;
+
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec)
+    + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+#if HAVE_STATVFS
+/* A statvfs probe of a mounted file system.  */
+struct statvfs_probe
+{
+  char const *sp_mountdir;
+  bool sp_readonly;
+};
+
+static void
+run_statvfs_probe (void *arg)
+{
+  struct statvfs_probe *sp = arg;
+  struct statvfs buf;
+
+  sp->sp_readonly = (statvfs (sp->sp_mountdir, &buf) == 0
+		     && (buf.f_flag & ST_RDONLY));
+}
+#endif
+
+/* Confirm with statvfs the readonly state of the file systems that are
+   going to be checked, running the probes concurrently.  The file systems
+   whose probe times out are marked as unknown.  */
+
+static void
+verify_entries (int argc, char **argv)
+{
+#if HAVE_STATVFS
+  struct mount_entry **entries;
+  struct statvfs_probe *sps;
+  struct probe *probes;
+  struct timespec start;
+  size_t i, n;
+
+  entries = checked_entries (argc, argv, &n);
+  sps = xnmalloc (n ? n : 1, sizeof *sps);
+  probes = xnmalloc (n ? n : 1, sizeof *probes);
+  for (i = 0; i < n; i++)
+    {
+      sps[i].sp_mountdir = entries[i]->me_mountdir;
+      sps[i].sp_readonly = false;
+      probes[i].pr_arg = &sps[i];
+    }
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  probe_timeouts = run_probes (probes, n, run_statvfs_probe,
+			       probe_workers, probe_timeout);
+  probe_time = elapsed_since (&start);
+
+  for (i = 0; i < n; i++)
+    {
+      if (probes[i].pr_state == PROBE_TIMEDOUT)
+	entries[i]->me_unknown = 1;
+      else if (sps[i].sp_readonly)
+	entries[i]->me_readonly = 1;
+    }
+
+  /* The threads stuck in timed out probes may still write to them.  */
+  if (probe_timeouts == 0)
+    {
+      free (sps);
+      free (probes);
+    }
+  free (entries);
+#else
+  (void) argc;
+  (void) argv;
+  error (STATE_UNKNOWN, 0, "statvfs is not supported on this system\n");
+#endif
+}
+
+/* A write probe of a mounted file system: the creation of a temporary
+   file in the directory wp_dir, the writing of a byte to it, and its
+   removal.  The outcome of a probe done in time is in wp_errno, which is
+   zero if the file system could be written.  */
+struct write_probe
+{
+  struct mount_entry *wp_entry;
+  char *wp_dir;
+  char *wp_template;		/* For mkstemp, when O_TMPFILE fails. */
+  int wp_errno;
+  bool wp_timedout;
+};
+
+static void
+run_write_probe (void *arg)
+{
+  struct write_probe *wp = arg;
+  int fd = -1;
+
+  /* An unnamed file is never seen by the other processes, and it is
+     removed even if the plugin is killed.  Not all the file systems
+     support it, though.  */
+#ifdef O_TMPFILE
+  fd = open (wp->wp_dir, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0600);
+  if (fd < 0 && errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)
+    {
+      wp->wp_errno = errno;
+      return;
+    }
+#endif
+  if (fd < 0)
+    {
+      fd = mkstemp (wp->wp_template);
+      if (fd < 0)
+	{
+	  wp->wp_errno = errno;
+	  return;
+	}
+      unlink (wp->wp_template);
+    }
+
+  /* A write is only cached in memory: the failure of the device, or a
+     thin pool out of space, is only seen when it is flushed.  */
+  if (write (fd, "", 1) != 1 || fdatasync (fd) != 0)
+    wp->wp_errno = errno;
+  else
+    wp->wp_errno = 0;
+  close (fd);
+}
+
+/* Return true if ERRNUM, the outcome of a write probe, means that the
+   file system cannot be written.  The other errors, like EACCES, only
+   mean that the probe could not be done.  */
+
+static bool
+write_probe_failed (int errnum)
+{
+  return errnum == EROFS || errnum == EIO;
+}
+
+static int
+compare_write_probes (void const *a, void const *b)
+{
+  uintptr_t pa = (uintptr_t) ((struct write_probe const *) a)->wp_entry;
+  uintptr_t pb = (uintptr_t) ((struct write_probe const *) b)->wp_entry;
+
+  return (pa > pb) - (pa < pb);
+}
+
+/* Return the state of ME shown in the list of the checked file systems,
+   if it was decided by a write probe, or NULL otherwise.  */
+
+static char const *
+write_probe_state (struct mount_entry const *me)
+{
+  static char state[128];
+  struct write_probe key, *wp;
+
+  if (n_write_probes == 0)
+    return NULL;
+
+  key.wp_entry = (struct mount_entry *) me;
+  wp = bsearch (&key, write_probes, n_write_probes, sizeof *write_probes,
+		compare_write_probes);
+  if (wp == NULL || wp->wp_timedout || wp->wp_errno == 0)
+    return NULL;
+
+  snprintf (state, sizeof state, "<< %s (%s)",
+	    write_probe_failed (wp->wp_errno) ? "not writable"
+	    : "write probe failed", strerror (wp->wp_errno));
+  return state;
+}
+
+/* Check that the file systems that are going to be checked, and which
+   are not known to be readonly, can actually be written, running the
+   probes concurrently.  The file systems that cannot be written are
+   marked as readonly, and the ones whose probe is not done by the
+   deadline of the phase, whether stuck or not started yet, as unknown.  */
+
+static void
+write_entries (int argc, char **argv)
+{
+  struct mount_entry **entries;
+  struct probe *probes;
+  struct timespec start;
+  size_t i, n, count = 0;
+
+  write_failures = 0;
+  entries = checked_entries (argc, argv, &n);
+  write_probes = xnmalloc (n ? n : 1, sizeof *write_probes);
+  for (i = 0; i < n; i++)
+    {
+      struct write_probe *wp = &write_probes[count];
+      struct mount_entry *me = entries[i];
+      size_t len;
+
+      if (me->me_readonly || me->me_unknown)
+	continue;
+
+      len = strlen (me->me_mountdir)
+	+ (write_probe_dir ? strlen (write_probe_dir) + 1 : 0);
+      wp->wp_entry = me;
+      wp->wp_dir = xmalloc (len + 1);
+      if (write_probe_dir)
+	sprintf (wp->wp_dir, "%s/%s", me->me_mountdir, write_probe_dir);
+      else
+	strcpy (wp->wp_dir, me->me_mountdir);
+      wp->wp_template = xmalloc (len + sizeof "/.check_readonlyfs.XXXXXX");
+      sprintf (wp->wp_template, "%s/.check_readonlyfs.XXXXXX", wp->wp_dir);
+      wp->wp_errno = 0;
+      wp->wp_timedout = false;
+      count++;
+    }
+  free (entries);
+
+  /* The probes are sorted by entry, to be found when listed.  */
+  qsort (write_probes, count, sizeof *write_probes, compare_write_probes);
+  probes = xnmalloc (count ? count : 1, sizeof *probes);
+  for (i = 0; i < count; i++)
+    probes[i].pr_arg = &write_probes[i];
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  write_timeouts = run_probes (probes, count, run_write_probe,
+			       probe_workers, probe_timeout);
+  write_time = elapsed_since (&start);
+
+  for (i = 0; i < count; i++)
+    {
+      struct write_probe *wp = &write_probes[i];
+
+      if (probes[i].pr_state == PROBE_TIMEDOUT)
+	{
+	  wp->wp_timedout = true;
+	  wp->wp_entry->me_unknown = 1;
+	}
+      else if (write_probe_failed (wp->wp_errno))
+	{
+	  wp->wp_entry->me_readonly = 1;
+	  write_failures++;
+	}
+    }
+
+  /* The threads stuck in timed out probes may still write to them.  */
+  if (write_timeouts == 0)
+    free (probes);
+  n_write_probes = count;
+}
+
+/* Release the write probes, unless some of them timed out.  */
+
+static void
+free_write_probes (void)
+{
+  size_t i;
+
+  if (write_timeouts == 0)
+    {
+      for (i = 0; i < n_write_probes; i++)
+	{
+	  free (write_probes[i].wp_dir);
+	  free (write_probes[i].wp_template);
+	}
+      free (write_probes);
+    }
+  write_probes = NULL;
+  n_write_probes = 0;
+}
+
 static void __attribute__ ((__noreturn__)) usage (FILE * out)
 {
   fprintf (out, "%s, version %s - check for readonly filesystems.\n",
@@ -233,7 +1048,40 @@ static void __attribute__ ((__noreturn__)) usage (FILE * out)
   -l, --local               limit listing to local file systems\n\
   -L, --list                display the list of checked file systems\n\
   -T, --type=TYPE           limit listing to file systems of type TYPE\n\
-  -X, --exclude-type=TYPE   limit listing to file systems not of type TYPE\n", out);
+  -X, --exclude-type=TYPE   limit listing to file systems not of type TYPE\n\
+                            (TYPE can be a glob pattern, like 'fuse.*')\n\
+  -I, --include-path=DIR    limit listing to file systems mounted on DIR or\n\
+                            below it\n\
+  -E, --exclude-path=DIR    limit listing to file systems not mounted on DIR\n\
+                            or below it (DIR can be a glob pattern, like\n\
+                            '/var/lib/docker/*', whose wildcards do not\n\
+                            match a '/')\n\
+  -N, --namespaces          check the file systems of every mount namespace\n\
+  -n, --no-automount        do not mount the automounted FILESYSTEMs, and\n\
+                            report the ones not currently mounted\n\
+  -s, --statvfs             confirm the readonly state with statvfs\n\
+  -w, --write[=DIR]         check that the file systems can be written, by\n\
+                            writing a temporary file in them, or in their\n\
+                            subdirectory DIR\n\
+  -t, --timeout=SECONDS     give up opening the FILESYSTEMs, the statvfs\n\
+                            calls, the writes or reading the mount\n\
+                            namespaces after SECONDS (default: 5)\n\
+  -j, --jobs=NUMBER         run up to NUMBER statvfs calls, writes or mount\n\
+                            namespace reads at once (default: 8)\n\
+  -W, --watch               wait until a file system turns readonly, and\n\
+                            report it\n\
+  -e, --exec=COMMAND        with --watch, keep watching and run COMMAND\n\
+                            with /bin/sh -c, with the mount points that\n\
+                            turned readonly as arguments, each time it\n\
+                            happens\n\
+  -p, --perfdata            report the time of each phase of the check, the\n\
+                            number of entries and the peak memory use as\n\
+                            performance data\n\
+  -C, --cache=FILE          cache the mount table in FILE until it changes\n\
+  -D, --daemon=SOCKET       keep the mount table in memory and answer the\n\
+                            queries sent to the UNIX socket SOCKET\n\
+  -S, --socket=SOCKET       query the daemon listening on SOCKET, if any\n",
+	 out);
   fputs (HELP_OPTION_DESCRIPTION, out);
   fputs (VERSION_OPTION_DESCRIPTION, out);
 
@@ -247,20 +1095,49 @@ print_version (void)
 	  program_copyright);
 }
 
-int
-main (int argc, char **argv)
-{
-  int c, status = STATE_OK;
-  struct stat *stats = 0;
+/* Set the options to their default values.  */
 
-  fs_select_list = NULL;
-  fs_exclude_list = NULL;
+static void
+reset_options (void)
+{
+  fstype_set_free (fs_select_set);
+  fstype_set_free (fs_exclude_set);
+  fs_select_set = NULL;
+  fs_exclude_set = NULL;
+  path_set_free (path_select_set);
+  path_set_free (path_exclude_set);
+  path_select_set = NULL;
+  path_exclude_set = NULL;
 
   show_local_fs = false;
   show_listed_fs = false;
   show_all_fs = false;
 
-  while ((c = getopt_long (argc, argv, "alLT:X:hv", longopts, NULL)) != -1)
+  scan_namespaces = false;
+  no_automount = false;
+  watch_fs = false;
+  watch_command = NULL;
+  show_perfdata = false;
+  verify_fs = false;
+  write_fs = false;
+  write_probe_dir = NULL;
+  probe_timeout = 5;
+  probe_workers = 8;
+
+  cache_file = NULL;
+  daemon_socket = NULL;
+  query_socket = NULL;
+}
+
+static void
+parse_options (int argc, char **argv)
+{
+  int c;
+
+  /* Also parse again from scratch when called by the daemon.  */
+  optind = 0;
+
+  while ((c = getopt_long (argc, argv, short_options, longopts, NULL)) != -1)
     {
       switch (c)
 	{
@@ -282,6 +1159,65 @@ main (int argc, char **argv)
 	case 'X':
 	  add_excluded_fs_type (optarg);
 	  break;
+	case 'I':
+	  add_path_pattern (&path_select_set, optarg);
+	  break;
+	case 'E':
+	  add_path_pattern (&path_exclude_set, optarg);
+	  break;
+	case 'N':
+	  scan_namespaces = true;
+	  break;
+	case 'n':
+#ifdef AT_NO_AUTOMOUNT
+	  no_automount = true;
+#else
+	  error (STATE_UNKNOWN, 0,
+		 "--no-automount is not supported on this system\n");
+#endif
+	  break;
+	case 's':
+	  verify_fs = true;
+	  break;
+	case 'w':
+	  write_fs = true;
+	  write_probe_dir = optarg;
+	  break;
+	case 't':
+	  {
+	    char *end;
+	    probe_timeout = strtod (optarg, &end);
+	    if (end == optarg || *end != '\0' || probe_timeout < 0)
+	      error (STATE_UNKNOWN, 0, "invalid timeout `%s'\n", optarg);
+	  }
+	  break;
+	case 'j':
+	  {
+	    char *end;
+	    unsigned long jobs = strtoul (optarg, &end, 10);
+	    if (end == optarg || *end != '\0' || jobs == 0 || jobs > 1024)
+	      error (STATE_UNKNOWN, 0, "invalid number of jobs `%s'\n", optarg);
+	    probe_workers = jobs;
+	  }
+	  break;
+	case 'W':
+	  watch_fs = true;
+	  break;
+	case 'e':
+	  watch_command = optarg;
+	  break;
+	case 'p':
+	  show_perfdata = true;
+	  break;
+	case 'C':
+	  cache_file = optarg;
+	  break;
+	case 'D':
+	  daemon_socket = optarg;
+	  break;
+	case 'S':
+	  query_socket = optarg;
+	  break;
 
 	case_GETOPT_HELP_CHAR
         case_GETOPT_VERSION_CHAR
@@ -289,74 +1225,564 @@ main (int argc, char **argv)
 	}
     }
 
+  if (scan_namespaces && (optind < argc || verify_fs || write_fs))
+    error (STATE_UNKNOWN, 0, "--namespaces cannot be used with --statvfs, "
+	   "--write or FILESYSTEM\n");
+
+  if (watch_fs && (optind < argc || scan_namespaces || verify_fs || write_fs
+		   || cache_file || daemon_socket || query_socket))
+    error (STATE_UNKNOWN, 0, "--watch cannot be used with --namespaces, "
+	   "--statvfs, --write, --cache, --daemon, --socket or FILESYSTEM\n");
+  if (watch_command && !watch_fs)
+    error (STATE_UNKNOWN, 0, "--exec can only be used with --watch\n");
+  /* Never run a command sent by a client of the daemon.  */
+  if ((watch_fs || watch_command) && mountd_answering ())
+    error (STATE_UNKNOWN, 0, "--watch and --exec cannot be sent to the "
+	   "daemon\n");
+
   /* Fail if the same file system type was both selected and excluded.  */
-  {
-    struct fs_type_list *fs_incl;
-    for (fs_incl = fs_select_list; fs_incl; fs_incl = fs_incl->fs_next)
-      {
-	struct fs_type_list *fs_excl;
-	for (fs_excl = fs_exclude_list; fs_excl; fs_excl = fs_excl->fs_next)
-	  {
-	    if (STREQ (fs_incl->fs_name, fs_excl->fs_name))
-	      error (STATE_UNKNOWN, 0,
-		     "file system type `%s' both selected and excluded\n",
-		     fs_incl->fs_name);
-	  }
-      }
-  }
+  if (fs_select_set && fs_exclude_set)
+    {
+      char const *fstype = fstype_set_conflict (fs_select_set,
+						fs_exclude_set);
+      if (fstype)
+	error (STATE_UNKNOWN, 0,
+	       "file system type `%s' both selected and excluded\n", fstype);
+    }
+}
 
-  if (optind < argc)
+/* Print to stdout the performance data of the probes.  */
+
+static void
+print_probe_perfdata (void)
+{
+  if (verify_fs)
+    printf (" probe_time=%.3fms probe_timeouts=%lu",
+	    probe_time * 1e3, (unsigned long) probe_timeouts);
+  if (write_fs)
+    printf (" write_time=%.3fms write_failures=%lu write_timeouts=%lu",
+	    write_time * 1e3, (unsigned long) write_failures,
+	    (unsigned long) write_timeouts);
+}
+
+/* Print the plugin output for STATUS, turned into STATE_UNKNOWN if some
+   file systems are in an unknown state, and return it.  */
+
+static int
+report_status (int status)
+{
+  double start = perf_start ();
+
+  if ((n_unknown_fs > 0 || n_unreadable_fs > 0) && status == STATE_OK)
+    status = STATE_UNKNOWN;
+
+  if (!show_listed_fs)
     {
-      int i;
+      size_t i;
 
-      /* Open each of the given entries to make sure any corresponding
-       * partition is automounted.  This must be done before reading the
-       * file system table.  */
-      stats = xnmalloc (argc - optind, sizeof *stats);
-      for (i = optind; i < argc; ++i)
+      if (status == STATE_OK)
+	fputs ("FILESYSTEMS OK", stdout);
+      else if (status == STATE_CRITICAL)
+	fputs (" readonly!", stdout);
+      else
+	fputs ("FILESYSTEMS UNKNOWN:", stdout);
+
+      for (i = 0; i < n_unknown_fs; i++)
+	printf ("%s%s", i ? "," : " ", unknown_fs[i]);
+      if (n_unknown_fs > 0)
+	fputs (" timed out", stdout);
+      for (i = 0; i < n_unreadable_fs; i++)
+	printf ("%s%s", i ? "," : n_unknown_fs ? ", " : " ",
+		unreadable_fs[i]);
+      if (n_unreadable_fs > 0)
+	fputs (" unreadable", stdout);
+      for (i = 0; i < n_unmounted_fs; i++)
+	printf ("%s%s", i ? "," : " (not currently mounted: ",
+		unmounted_fs[i]);
+      if (n_unmounted_fs > 0)
+	putchar (')');
+
+      perf_stop (PERF_OUTPUT, start);
+      if (verify_fs || write_fs || show_perfdata)
+	fputs (" |", stdout);
+      print_probe_perfdata ();
+      perf_print (stdout);
+      putchar ('\n');
+    }
+  else if (show_perfdata)
+    {
+      /* The performance data follow the list of the file systems.  */
+      perf_stop (PERF_OUTPUT, start);
+      fputs ("|", stdout);
+      print_probe_perfdata ();
+      perf_print (stdout);
+      putchar ('\n');
+    }
+
+  return status;
+}
+
+/* Check the file systems of every mount namespace.  The readonly ones are
+   reported grouped by namespace, followed by the namespace identifier and
+   by the PID of one of its processes.  */
+
+static int
+check_namespaces (void)
+{
+  struct mount_namespace *namespaces;
+  int status = STATE_OK;
+  size_t i, n;
+  double start = perf_start ();
+
+  namespaces = read_mount_namespaces (&n, mount_fields (), probe_workers,
+				      probe_timeout);
+  if (namespaces == NULL)
+    error (STATE_UNKNOWN, errno, "cannot scan the mount namespaces\n");
+  perf_stop (PERF_READ, start);
+
+  start = perf_start ();
+  for (i = 0; i < n; i++)
+    {
+      struct mount_namespace *ns = &namespaces[i];
+      size_t readonly = n_readonly_fs;
+
+      /* Only the namespaces whose processes all exited are dropped.  */
+      if (ns->mn_timedout || ns->mn_unreadable)
 	{
-	  /* Prefer to open with O_NOCTTY and use fstat, but fall back
-	   * on using "stat", in case the file is unreadable.  */
-	  int fd = open (argv[i], O_RDONLY | O_NOCTTY);
-	  if ((fd < 0 || fstat (fd, &stats[i - optind]))
-	      && stat (argv[i], &stats[i - optind]))
+	  char *name = xmalloc (sizeof "mnt:[]" + 3 * sizeof (uintmax_t));
+	  sprintf (name, "mnt:[%ju]", (uintmax_t) ns->mn_id);
+	  if (ns->mn_timedout)
+	    add_unknown_fs (name);
+	  else
 	    {
-	      error (0, 0, "cannot open `%s'\n", argv[i]);
-	      argv[i] = NULL;
+	      unreadable_fs = xrealloc (unreadable_fs, (n_unreadable_fs + 1)
+					* sizeof *unreadable_fs);
+	      unreadable_fs[n_unreadable_fs++] = name;
 	    }
-	  if (0 <= fd)
-	    close (fd);
+	  continue;
+	}
+      if (ns->mn_list == NULL)
+	continue;
+
+      if (show_listed_fs)
+	printf ("mount namespace mnt:[%ju] (pid %ld)\n",
+		(uintmax_t) ns->mn_id, (long) ns->mn_pid);
+      mount_list = ns->mn_list;
+      if (check_all_entries () == STATE_CRITICAL)
+	status = STATE_CRITICAL;
+      if (n_readonly_fs > readonly && !show_listed_fs)
+	printf (" in mnt:[%ju] (pid %ld)", (uintmax_t) ns->mn_id,
+		(long) ns->mn_pid);
+    }
+  mount_list = NULL;
+  perf_stop (PERF_FILTER, start);
+
+  status = report_status (status);
+  free_mount_namespaces (namespaces, n);
+  return status;
+}
+
+/* Return the mount list of the table of mounted file systems read again
+   after a change, timing it if the performance data are reported.  */
+
+static struct mount_entry *
+reread_mount_list (void)
+{
+  struct mount_entry *list;
+  double start;
+
+  perf_enable (show_perfdata);
+  start = perf_start ();
+  list = read_file_system_list (mount_fields ());
+  perf_stop (PERF_READ, start);
+
+  return list;
+}
+
+/* Return true if the file system ME, to be checked, is readonly while the
+   same mount, that is the one of the same file system on the same mount
+   point, was not in the list indexed by OLD_INDEX.  */
+
+static bool
+turned_readonly (struct mount_entry const *me,
+		 struct mount_index const *old_index)
+{
+  struct mount_entry **old;
+  size_t i, n;
+
+  if (!me->me_readonly)
+    return false;
+
+  old = mount_index_lookup (old_index, me->me_mountdir, &n);
+  for (i = 0; i < n; i++)
+    if (old[i]->me_dev == me->me_dev && !old[i]->me_readonly)
+      return true;
+
+  return false;
+}
+
+/* Run the --exec command with the mount points of the N ENTRIES as
+   arguments, without waiting for it.  */
+
+static void
+run_watch_command (struct mount_entry **entries, size_t n)
+{
+  char **argv = xnmalloc (n + 5, sizeof *argv);
+  size_t i;
+
+  argv[0] = (char *) "sh";
+  argv[1] = (char *) "-c";
+  argv[2] = (char *) watch_command;
+  argv[3] = (char *) "sh";
+  for (i = 0; i < n; i++)
+    argv[4 + i] = entries[i]->me_mountdir;
+  argv[4 + n] = NULL;
+
+  fflush (stdout);
+  switch (fork ())
+    {
+    case -1:
+      error (0, errno, "cannot run `%s'\n", watch_command);
+      break;
+    case 0:
+      execv ("/bin/sh", argv);
+      _exit (127);
+    }
+  free (argv);
+}
+
+/* Wait until some of the checked file systems turn readonly, and report
+   them.  The table is read again each time the kernel reports a change,
+   and compared with the previous one: the changes notified while it is
+   read are reported by the next poll, so that they are never missed, and
+   a storm of mounts costs a read of the table per poll rather than per
+   mount.  Return STATE_CRITICAL, or keep watching and run the --exec
+   command each time if it is given.  */
+
+static int
+watch_filesystems (void)
+{
+  struct mount_entry *old_list, *new_list, *me, **entries = NULL;
+  struct mount_index *old_index;
+  struct pollfd pfd;
+  size_t n, alloc = 0;
+
+  /* The changes are notified from the opening of the watch on, so that
+     the ones made while the first table is read are not missed.  */
+  pfd.fd = open_mount_table_watch ();
+  pfd.events = POLLPRI;
+  if (pfd.fd < 0)
+    error (STATE_UNKNOWN, errno,
+	   "cannot watch the table of mounted file systems\n");
+
+  old_list = read_file_system_list (mount_fields ());
+  if (old_list == NULL)
+    error (STATE_UNKNOWN, 0, "cannot read table of mounted file systems\n");
+  old_index = mount_index_new (old_list);
+
+  if (watch_command)
+    /* Let the kernel reap the commands.  */
+    signal (SIGCHLD, SIG_IGN);
+
+  for (;;)
+    {
+      if (poll (&pfd, 1, -1) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  error (STATE_UNKNOWN, errno,
+		 "cannot watch the table of mounted file systems\n");
 	}
-      free (stats);
+      if (!(pfd.revents & (POLLPRI | POLLERR)))
+	continue;
+
+      /* Keep the old table if the new one cannot be read.  */
+      new_list = reread_mount_list ();
+      if (new_list == NULL)
+	continue;
+
+      n = 0;
+      for (me = new_list; me; me = me->me_next)
+	if (!skip_mount_entry (me) && turned_readonly (me, old_index))
+	  {
+	    if (n == alloc)
+	      entries = xrealloc (entries, (alloc = alloc ? 2 * alloc : 16)
+				  * sizeof *entries);
+	    entries[n++] = me;
+	  }
+
+      if (n > 0)
+	{
+	  size_t i;
+
+	  for (i = 0; i < n; i++)
+	    check_mount_entry (entries[i]);
+	  report_status (STATE_CRITICAL);
+	  if (watch_command == NULL)
+	    return STATE_CRITICAL;
+
+	  run_watch_command (entries, n);
+	  n_readonly_fs = 0;
+	}
+
+      mount_index_free (old_index);
+      free_mount_list (old_list);
+      old_list = new_list;
+      old_index = mount_index_new (old_list);
+    }
+}
+
+static int
+check_filesystems (int argc, char **argv)
+{
+  int status = STATE_OK;
+  bool cached;
+  double start;
+
+  perf_enable (show_perfdata);
+  if (scan_namespaces)
+    return check_namespaces ();
+  if (watch_fs)
+    return watch_filesystems ();
+
+  if (optind < argc)
+    {
+      start = perf_start ();
+      trigger_automounts (argc, argv);
+      perf_stop (PERF_TRIGGER, start);
+    }
+
+  start = perf_start ();
+  mount_list = mountd_mount_list (&mount_index);
+  mount_table = mountd_mount_table ();
+  cached = (mount_list != NULL);
+  set_mount_list_cache (cache_file);
+
+  /* Without arguments, daemon, cache or probes, each file system is
+     checked as the table is read, and the list is never built.  */
+  if (!cached && !cache_file && optind >= argc && !verify_fs && !write_fs)
+    {
+      if (walk_file_system_list (mount_fields (), check_walked_entry,
+				 &status) < 0)
+	error (STATE_UNKNOWN, 0,
+	       "cannot read table of mounted file systems\n");
+      perf_stop (PERF_READ, start);
+      perf_discount (PERF_READ, PERF_FILTER);
+      return report_status (status);
     }
 
-  mount_list =
-    read_file_system_list ((fs_select_list != NULL
-			    || fs_exclude_list != NULL || show_local_fs));
+  /* With arguments, only the mounts holding them are read if possible,
+     so that the cost does not depend on the size of the table.  */
+  if (!cached && optind < argc)
+    mount_list = read_argument_mounts (argc, argv);
+  if (!cached && mount_list == NULL)
+    mount_list = read_file_system_list (mount_fields ());
 
   if (NULL == mount_list)
     /* Couldn't read the table of mounted file systems. */
     error (STATE_UNKNOWN, 0, "cannot read table of mounted file systems\n");
+  perf_stop (PERF_READ, start);
 
   if (optind < argc)
     {
       int i;
 
+      if (perf_enabled ())
+	{
+	  struct mount_entry *me;
+
+	  for (me = mount_list; me; me = me->me_next)
+	    perf_count (PERF_ENTRIES_READ, 1);
+	}
+
+      start = perf_start ();
+      if (!cached && !argument_mounts)
+	mount_index = mount_index_new (mount_list);
+      perf_stop (PERF_LOOKUP, start);
+      if (verify_fs)
+	verify_entries (argc, argv);
+      if (write_fs)
+	write_entries (argc, argv);
+
+      start = perf_start ();
       for (i = optind; i < argc; ++i)
-	if (argv[i] && (check_entry (argv[i]) == STATE_CRITICAL))
-	  {
-	    if (!show_listed_fs)
-	      printf ("%s%s",
-		      status == STATE_OK ? "FILESYSTEMS CRITICAL: " : ",",
-		      argv[i]);
-	    status = STATE_CRITICAL;
-	  }
+	{
+	  int entry_status;
+
+	  if (argv[i] == NULL)
+	    continue;
+
+	  entry_status = check_entry (argv, i);
+	  if (entry_status == STATE_CRITICAL)
+	    {
+	      if (!show_listed_fs)
+		printf ("%s%s",
+			n_readonly_fs == 0 ? "FILESYSTEMS CRITICAL: " : ",",
+			argv[i]);
+	      n_readonly_fs++;
+	      status = STATE_CRITICAL;
+	    }
+	  else if (entry_status == STATE_UNKNOWN)
+	    add_unknown_fs (argv[i]);
+	}
+      perf_stop (PERF_LOOKUP, start);
     }
   else
-    status = check_all_entries ();
+    {
+      if (verify_fs)
+	verify_entries (argc, argv);
+      if (write_fs)
+	write_entries (argc, argv);
+      if (mount_table && (verify_fs || write_fs))
+	mount_table_update (mount_table);
+      start = perf_start ();
+      status = check_all_entries ();
+      perf_stop (PERF_FILTER, start);
+    }
 
-  if (!show_listed_fs)
-    printf ("%s\n", (status == STATE_OK) ? "FILESYSTEMS OK" : " readonly!");
+  status = report_status (status);
 
+  free_write_probes ();
+  free (argument_mounts);
+  argument_mounts = NULL;
+  mount_trie_free (mount_trie);
+  mount_trie = NULL;
+  if (!cached)
+    {
+      mount_index_free (mount_index);
+      free_mount_list (mount_list);
+    }
   return status;
 }
+
+/* Return the command line ARGC, ARGV to be sent to the daemon, that is
+   without the --socket option, and store its length in *N.  The options
+   are those found by parse_options, optind is left unchanged.  */
+
+static char **
+query_arguments (int argc, char **argv, int *n)
+{
+  size_t alloc = 16;
+  char **qargv = xnmalloc (alloc, sizeof *qargv);
+  int c, saved_optind = optind;
+
+  qargv[0] = argv[0];
+  *n = 1;
+  optind = 0;
+  opterr = 0;
+  while ((c = getopt_long (argc, argv, short_options, longopts, NULL)) != -1)
+    {
+      char *opt;
+
+      if (c == 'S')
+	continue;
+      if (*n + 2 > (int) alloc)
+	qargv = xrealloc (qargv, (alloc *= 2) * sizeof *qargv);
+
+      /* The optional argument of --write must be attached to it.  */
+      opt = xmalloc (3 + (c == 'w' && optarg ? strlen (optarg) : 0));
+      sprintf (opt, "-%c%s", c, c == 'w' && optarg ? optarg : "");
+      qargv[(*n)++] = opt;
+      if (c != 'w' && optarg)
+	qargv[(*n)++] = optarg;
+    }
+  opterr = 1;
+
+  qargv = xrealloc (qargv, (*n + 2 + argc - optind) * sizeof *qargv);
+  qargv[(*n)++] = (char *) "--";
+  while (optind < argc)
+    qargv[(*n)++] = argv[optind++];
+  qargv[*n] = NULL;
+
+  optind = saved_optind;
+  return qargv;
+}
+
+/* Return the first option of the command line ARGC, ARGV that the daemon
+   refuses to answer, or NULL if there is none.  As the queries are run
+   with the credentials of the daemon, its clients are not allowed to
+   serve queries, to write files where they choose or to run commands.
+   optind is left unchanged.  */
+
+static char const *
+refused_query_option (int argc, char **argv)
+{
+  char const *refused = NULL;
+  int c, saved_optind = optind;
+
+  optind = 0;
+  opterr = 0;
+  while (refused == NULL
+	 && (c = getopt_long (argc, argv, short_options, longopts, NULL))
+	 != -1)
+    switch (c)
+      {
+      case 'C':
+	refused = "--cache";
+	break;
+      case 'D':
+	refused = "--daemon";
+	break;
+      case 'S':
+	refused = "--socket";
+	break;
+      case 'W':
+	refused = "--watch";
+	break;
+      case 'e':
+	refused = "--exec";
+	break;
+      case 'w':
+	if (optarg)
+	  refused = "--write=DIR";
+	break;
+      }
+  opterr = 1;
+  optind = saved_optind;
+
+  return refused;
+}
+
+/* Answer a query sent to the daemon, starting from the default options
+   rather than from the ones of the daemon.  */
+static int
+daemon_query (int argc, char **argv)
+{
+  char const *option = refused_query_option (argc, argv);
+
+  if (option)
+    error (STATE_UNKNOWN, 0, "%s cannot be sent to the daemon\n", option);
+
+  reset_options ();
+  parse_options (argc, argv);
+  return check_filesystems (argc, argv);
+}
+
+int
+main (int argc, char **argv)
+{
+  reset_options ();
+  parse_options (argc, argv);
+
+  if (daemon_socket)
+    {
+      mountd_serve (daemon_socket, daemon_query);
+      error (STATE_UNKNOWN, errno, "cannot serve queries on `%s'\n",
+	     daemon_socket);
+    }
+
+  if (query_socket)
+    {
+      /* Do the check by ourselves if the daemon is not running, or
+	 would refuse the query.  */
+      int qargc, status = -1;
+      char **qargv = query_arguments (argc, argv, &qargc);
+
+      if (refused_query_option (qargc, qargv) == NULL)
+	status = mountd_query (query_socket, qargc, qargv);
+      if (status >= 0)
+	return status;
+    }
+
+  return check_filesystems (argc, argv);
+}